@@ -0,0 +1,256 @@
+/*
+ * ac_measurement.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      AC frequency (zero crossing) and RMS over whole cycles, streaming
+ *      one sample at a time - integer arithmetic only (no FPU)
+ *      No Arduino dependency, can be compiled on the host for tuning
+ */
+
+#ifndef AC_MEASUREMENT_H_
+#define AC_MEASUREMENT_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include <stdint.h>
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+/**
+ * Sample positions, sample rate and RMS are fixed point Q8
+ */
+static const uint8_t ac_q= 8;
+
+//Default window [cycles] - 10 cycles: 200ms at 50Hz, 167ms at 60Hz
+static const uint8_t ac_window_cycles_default= 10;
+
+//Default zero crossing hysteresis [ADC counts]
+static const int32_t ac_hysteresis_default= 40;
+
+//Default DC bias of the waveform - mid scale of a 12 bits ADC [ADC counts]
+static const int32_t ac_dc_default= 2048;
+
+//Signal lost - no zero crossing for 100ms (below 10Hz)
+static const uint16_t ac_timeout_per_second= 10;
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+typedef struct{
+	//Configuration
+	uint8_t window_cycles;		//Cycles per result
+	int32_t hysteresis;			//Zero crossing hysteresis [ADC counts]
+	uint32_t sample_rate;		//Samples per second [Q8]
+
+	//Streaming state
+	int32_t dc;					//DC bias - mean of the last window [ADC counts]
+	int32_t prev;				//Previous sample without DC bias
+	bool armed;					//Negative half cycle seen - next rising crossing counts
+	bool positive;				//Positive half cycle seen since the last crossing - arming allowed
+	uint32_t position;			//Sample counter (free running)
+	uint32_t first_crossing;	//First rising crossing of the window [Q8 samples]
+	uint32_t since_crossing;	//Samples since the last rising crossing
+	uint8_t cycles;				//Cycles on the window (0= waiting the first crossing)
+	int64_t sum;				//Sum of the window samples without DC bias
+	uint64_t sum_squares;		//Sum of the window samples squared
+	uint32_t samples;			//Window samples
+
+	//Results - updated at the end of each window
+	uint32_t frequency;			//Frequency [mHz]
+	uint32_t rms;				//RMS without DC bias [Q8 ADC counts]
+	uint16_t windows;			//Results computed (changes on each new result)
+	bool valid;					//Signal present - results updated
+}_ac_measurement;
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the measurement - @sample_rate [samples/s Q8]
+ * ----------------------------------------------------------------*/
+void ac_init(_ac_measurement *ac, uint32_t sample_rate);
+
+/*------------------------------------------------------------------
+ * Restart the window (samples lost or signal lost)
+ * ----------------------------------------------------------------*/
+void ac_restart(_ac_measurement *ac);
+
+/*------------------------------------------------------------------
+ * Set the sample rate [samples/s Q8] (measured by the caller)
+ * ----------------------------------------------------------------*/
+void ac_set_sample_rate(_ac_measurement *ac, uint32_t sample_rate);
+
+/*------------------------------------------------------------------
+ * Integer square root
+ * ----------------------------------------------------------------*/
+uint32_t ac_isqrt(uint64_t value);
+
+/*------------------------------------------------------------------
+ * New @sample [ADC counts] - return true when a new result is computed
+ * ----------------------------------------------------------------*/
+bool ac_sample(_ac_measurement *ac, int32_t sample);
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the measurement - @sample_rate [samples/s Q8]
+ * ----------------------------------------------------------------*/
+void ac_init(_ac_measurement *ac, uint32_t sample_rate){
+	ac->window_cycles= ac_window_cycles_default;
+	ac->hysteresis= ac_hysteresis_default;
+	ac->sample_rate= sample_rate;
+
+	ac->dc= ac_dc_default;
+	ac->position= 0;
+	ac->frequency= 0;
+	ac->rms= 0;
+	ac->windows= 0;
+	ac->valid= false;
+
+	ac_restart(ac);
+}
+
+/*------------------------------------------------------------------
+ * Restart the window (samples lost or signal lost)
+ * ----------------------------------------------------------------*/
+void ac_restart(_ac_measurement *ac){
+	ac->prev= 0;
+	ac->armed= false;
+	ac->positive= true;
+	ac->first_crossing= 0;
+	ac->since_crossing= 0;
+	ac->cycles= 0;
+	ac->sum= 0;
+	ac->sum_squares= 0;
+	ac->samples= 0;
+}
+
+/*------------------------------------------------------------------
+ * Set the sample rate [samples/s Q8] (measured by the caller)
+ * ----------------------------------------------------------------*/
+void ac_set_sample_rate(_ac_measurement *ac, uint32_t sample_rate){
+	ac->sample_rate= sample_rate;
+}
+
+/*------------------------------------------------------------------
+ * Integer square root (bit by bit)
+ * ----------------------------------------------------------------*/
+uint32_t ac_isqrt(uint64_t value){
+	uint64_t root= 0;
+	uint64_t bit= (uint64_t)1 << 62;
+
+	while(bit > value)
+		bit>>= 2;
+
+	while(bit){
+		if(value >= root + bit){
+			value-= root + bit;
+			root= (root >> 1) + bit;
+		}
+		else{
+			root>>= 1;
+		}
+		bit>>= 2;
+	}
+
+	return((uint32_t)root);
+}
+
+/*------------------------------------------------------------------
+ * New @sample [ADC counts] - return true when a new result is computed
+ * Rising zero crossings (after the signal went above +hysteresis and
+ * then below -hysteresis) are interpolated between samples. A window spans window_cycles whole
+ * cycles: the frequency is the cycles over the window time and the RMS
+ * is computed on the same samples without their mean (DC bias)
+ * ----------------------------------------------------------------*/
+bool ac_sample(_ac_measurement *ac, int32_t sample){
+	int32_t x= sample - ac->dc;
+	int32_t prev= ac->prev;
+	bool result= false;
+
+	ac->prev= x;
+	ac->position++;
+
+	//Schmitt trigger - arm on the negative half only after the positive one,
+	//a DC bias update larger than the hysteresis can not count a cycle twice
+	if(x >= ac->hysteresis)
+		ac->positive= true;
+	if(ac->positive && (x <= -ac->hysteresis)){
+		ac->armed= true;
+		ac->positive= false;
+	}
+
+	//Signal lost - no crossing for too long
+	if(++ac->since_crossing > ((ac->sample_rate >> ac_q) / ac_timeout_per_second)){
+		ac->valid= false;
+		ac_restart(ac);
+		ac->prev= x;
+		return(false);
+	}
+
+	//Window samples (from the first crossing)
+	if(ac->cycles > 0){
+		ac->sum+= x;
+		ac->sum_squares+= (uint64_t)((int64_t)x * x);
+		ac->samples++;
+	}
+
+	//Rising zero crossing between the previous sample and this one
+	if(!ac->armed || (prev >= 0) || (x < 0))
+		return(false);
+
+	ac->armed= false;
+	ac->since_crossing= 0;
+	uint32_t crossing= ((ac->position - 1) << ac_q) + (uint32_t)(((int64_t)(-prev) << ac_q) / (x - prev));
+
+	//First crossing - window starts
+	if(ac->cycles == 0){
+		ac->first_crossing= crossing;
+		ac->cycles= 1;
+		ac->sum= 0;
+		ac->sum_squares= 0;
+		ac->samples= 0;
+		return(false);
+	}
+
+	//Window complete - this crossing starts the next one
+	if(ac->cycles++ >= ac->window_cycles){
+		uint32_t span= crossing - ac->first_crossing;
+
+		if((span > 0) && (ac->samples > 0)){
+			ac->frequency= (uint32_t)(((uint64_t)ac->window_cycles * ac->sample_rate * 1000) / span);
+
+			//Mean square without the mean [Q16]
+			int64_t mean_q8= (ac->sum << ac_q) / (int64_t)ac->samples;
+			int64_t mean_square= (int64_t)((ac->sum_squares << (2 * ac_q)) / ac->samples) - mean_q8 * mean_q8;
+			ac->rms= (mean_square > 0) ? ac_isqrt((uint64_t)mean_square) : 0;
+
+			//DC bias follows the window mean
+			ac->dc+= (int32_t)(mean_q8 >> ac_q);
+
+			ac->windows++;
+			ac->valid= true;
+			result= true;
+		}
+
+		ac->first_crossing= crossing;
+		ac->cycles= 1;
+		ac->sum= 0;
+		ac->sum_squares= 0;
+		ac->samples= 0;
+	}
+
+	return(result);
+}
+
+
+#endif /* AC_MEASUREMENT_H_ */
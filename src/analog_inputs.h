@@ -12,16 +12,96 @@
  * 						HEADERS
  * ----------------------------------------------------------------*/
 #include "hal/board.h"
+#include "ac_measurement.h"
 
 
 /*------------------------------------------------------------------
  * 					GLOBAL CONSTANTS
  * ----------------------------------------------------------------*/
+/**
+ * Hardware pin of each analogue input
+ */
+const uint8_t ai_pins[]= {analogue_input1, analogue_input2, analogue_input3, analogue_input4};
+const uint8_t ai_inputs_nr= sizeof(ai_pins) / sizeof(ai_pins[0]);
+
+/**
+ * ADC free running scan of all inputs, samples moved to memory by the PDC
+ * ADC clock= MCK / ((prescaler + 1) * 2)= 1MHz - about 50k samples/s shared
+ * by the inputs (12.5k samples/s each with 4 inputs)
+ */
+const uint8_t ai_adc_prescaler= 41;
+const uint8_t ai_adc_channels_nr= 16;
+const uint8_t ai_channel_none= 0xFF;
+const uint16_t ai_sample_mask= 0x0FFF;	//12 bits sample
+const uint8_t ai_sample_bits= 12;
+const uint8_t ai_sample_tag_shift= 12;	//Channel number tagged on the sample (bits 15..12)
+
+/**
+ * Oversampling and decimation - 4^n samples averaged give n extra bits
+ * 4 extra bits: 256 samples of 12 bits to 16 bits (0 - 65535)
+ * One DMA buffer holds the samples of one decimated value of each input
+ * (about 20ms per buffer)
+ */
+const uint8_t ai_oversampling_bits= 4;
+const uint16_t ai_oversampling_samples= (1 << (2 * ai_oversampling_bits));
+const uint16_t ai_buffer_size= ai_inputs_nr * ai_oversampling_samples;
+const int32_t ai_raw_full_scale= 65536;
+
+//Engineering values publication period [ms]
+const uint16_t ai_publish_period= 100;
+
+/**
+ * AC measurement (frequency and RMS) on the bus voltage transducer input
+ * Waveform biased at mid scale - scale of the input gives the RMS value
+ */
+const uint8_t ai_ac_input= 0; //analogue_input1
+
+//Sample rate filter - new rate weighted 1 / 2^n
+const uint8_t ai_sample_rate_filter= 3;
+
+//Default scale - millivolts (3.3V reference)
+const int32_t ai_full_scale_default= 3300;
+const int32_t ai_offset_default= 0;
 
 
 /*------------------------------------------------------------------
  * 					GLOBAL VARIABLES
  * ----------------------------------------------------------------*/
+//Each analogue input
+typedef struct{
+	//Scale - value= offset + raw * (full_scale - offset) / ai_raw_full_scale
+	int32_t full_scale;		//Engineering value at the ADC reference
+	int32_t offset;			//Engineering value at 0V
+
+	uint16_t raw;			//Last decimated value (16 bits)
+	int32_t value;			//Engineering value published
+}_analog_input;
+
+_analog_input analog_inputs[ai_inputs_nr];
+
+//Synchronization flag - new values published (bit per input)
+uint16_t analog_inputs_sync_flag;
+uint32_t ai_publish_time;	//Last publication [ms]
+
+//AC measurement of ai_ac_input - results on each window (whole cycles)
+_ac_measurement ai_ac;
+int32_t ai_ac_voltage;		//RMS [engineering value of ai_ac_input scale]
+uint32_t ai_ac_time;		//Last result [ms]
+
+//DMA double buffer - the PDC fills one buffer while the other is decimated
+uint16_t ai_dma_buffer[2][ai_buffer_size];
+volatile uint8_t ai_dma_active;		//Buffer being filled by the PDC
+volatile uint8_t ai_dma_filled;		//Last buffer filled
+volatile uint16_t ai_dma_count;		//Buffers filled (written by the ADC interrupt only)
+volatile uint32_t ai_dma_time;		//Last buffer filled [us]
+uint32_t ai_dma_read_time;			//Buffer filled on the last decimation [us]
+uint32_t ai_sample_rate;			//Samples per second of each input (measured) [Q8]
+uint16_t ai_dma_read_count;			//Buffers filled on the last decimation
+uint16_t ai_overruns;				//Buffers lost or overwritten before the decimation
+
+//ADC channel to analogue input index (ai_channel_none if not used)
+uint8_t ai_channel_input[ai_adc_channels_nr];
+uint32_t ai_channel_mask;
 
 
 /*------------------------------------------------------------------
@@ -32,15 +112,202 @@
  * ----------------------------------------------------------------*/
 void init_analog_inputs();
 
+/*------------------------------------------------------------------
+ * Set the scale of @input - engineering value at the ADC reference
+ * (@full_scale) and at 0V (@offset)
+ * ----------------------------------------------------------------*/
+void ai_set_scale(uint8_t input, int32_t full_scale, int32_t offset);
+
+/*------------------------------------------------------------------
+ * Decimate the DMA buffers filled and publish the engineering values
+ * each ai_publish_period - called from main loop each 1ms
+ * ----------------------------------------------------------------*/
+void manage_analog_inputs();
+
 
  /*------------------------------------------------------------------
  * 					FUNCTIONS DEFINITION
  * ----------------------------------------------------------------*/
 /*------------------------------------------------------------------
  * Initialize the hardware
+ * The ADC runs free in scan mode and the PDC moves the samples to the
+ * DMA buffers - one interrupt per buffer, no CPU per sample
+ * analogRead() must not be used after this initialization
  * ----------------------------------------------------------------*/
 void init_analog_inputs(){
 	analogReadResolution(12); //12 bits - Just arduino Due, Zero and MKR Family (0 - 4095)
+
+	for(uint8_t ch= 0; ch < ai_adc_channels_nr; ch++)
+		ai_channel_input[ch]= ai_channel_none;
+
+	ai_channel_mask= 0x00000000;
+	for(uint8_t i= 0; i < ai_inputs_nr; i++){
+		uint8_t channel= g_APinDescription[ai_pins[i]].ulADCChannelNumber;
+		ai_channel_input[channel]= i;
+		ai_channel_mask|= (1 << channel);
+
+		analog_inputs[i].full_scale= ai_full_scale_default;
+		analog_inputs[i].offset= ai_offset_default;
+		analog_inputs[i].raw= 0;
+		analog_inputs[i].value= ai_offset_default;
+	}
+
+	analog_inputs_sync_flag= 0x0000;
+	ai_publish_time= millis();
+	ai_dma_active= 0;
+	ai_dma_filled= 0;
+	ai_dma_count= 0;
+	ai_dma_time= 0;
+	ai_dma_read_count= 0;
+	ai_dma_read_time= 0;
+	ai_overruns= 0;
+
+	//Sample rate unknown until two buffers are timed
+	ai_sample_rate= 0;
+	ac_init(&ai_ac, ai_sample_rate);
+	ai_ac_voltage= 0;
+	ai_ac_time= 0;
+
+	//ADC stopped while configured
+	ADC->ADC_PTCR= PERIPH_PTCR_RXTDIS | PERIPH_PTCR_TXTDIS;
+	ADC->ADC_IDR= 0xFFFFFFFF;
+
+	//Scan of the inputs channels, free running, channel tagged on each sample
+	ADC->ADC_CHDR= 0xFFFF;
+	ADC->ADC_CHER= ai_channel_mask;
+	ADC->ADC_EMR|= ADC_EMR_TAG;
+	ADC->ADC_MR= (ADC->ADC_MR & ~ADC_MR_PRESCAL_Msk) | ADC_MR_PRESCAL(ai_adc_prescaler) | ADC_MR_FREERUN_ON;
+
+	//PDC double buffer - next buffer loaded by the hardware at the end of the current
+	ADC->ADC_RPR= (uintptr_t)ai_dma_buffer[0];
+	ADC->ADC_RCR= ai_buffer_size;
+	ADC->ADC_RNPR= (uintptr_t)ai_dma_buffer[1];
+	ADC->ADC_RNCR= ai_buffer_size;
+
+	ADC->ADC_IER= ADC_IER_ENDRX;
+	NVIC_EnableIRQ(ADC_IRQn);
+
+	ADC->ADC_PTCR= PERIPH_PTCR_RXTEN;
+	ADC->ADC_CR= ADC_CR_START;
+}
+
+/*------------------------------------------------------------------
+ * ADC interrupt - end of a DMA buffer
+ * The PDC is already filling the other buffer: the buffer filled is
+ * queued as the next one (decimated before the PDC gets back to it)
+ * ----------------------------------------------------------------*/
+void ADC_Handler(){
+	if(!(ADC->ADC_ISR & ADC_ISR_ENDRX))
+		return;
+
+	ai_dma_filled= ai_dma_active;
+	ai_dma_active^= 1;
+
+	//Writing the next counter clears ENDRX
+	ADC->ADC_RNPR= (uintptr_t)ai_dma_buffer[ai_dma_filled];
+	ADC->ADC_RNCR= ai_buffer_size;
+
+	ai_dma_time= micros();
+	ai_dma_count++;
+}
+
+/*------------------------------------------------------------------
+ * Set the scale of @input - engineering value at the ADC reference
+ * (@full_scale) and at 0V (@offset)
+ * ----------------------------------------------------------------*/
+void ai_set_scale(uint8_t input, int32_t full_scale, int32_t offset){
+	if(input >= ai_inputs_nr)
+		return;
+
+	analog_inputs[input].full_scale= full_scale;
+	analog_inputs[input].offset= offset;
+}
+
+/*------------------------------------------------------------------
+ * Decimate the DMA buffers filled and publish the engineering values
+ * each ai_publish_period - called from main loop each 1ms
+ * The samples of ai_ac_input are streamed to the AC measurement
+ * ----------------------------------------------------------------*/
+void manage_analog_inputs(){
+	uint16_t count;
+	uint8_t buffer;
+	uint32_t time;
+
+	//Buffer filled, its count and time from the same interrupt
+	do{
+		count= ai_dma_count;
+		buffer= ai_dma_filled;
+		time= ai_dma_time;
+	}while(count != ai_dma_count);
+
+	if(count != ai_dma_read_count){
+		//Buffers filled and never decimated - AC samples not continuous
+		if((uint16_t)(count - ai_dma_read_count) > 1){
+			ai_overruns++;
+			ac_restart(&ai_ac);
+		}
+		//Sample rate from two consecutive buffers
+		else if(ai_dma_read_time != 0){
+			uint32_t rate= (uint32_t)(((uint64_t)ai_oversampling_samples * 1000000 << ac_q) / (uint32_t)(time - ai_dma_read_time));
+
+			if(ai_sample_rate == 0)
+				ai_sample_rate= rate;
+			else
+				ai_sample_rate+= ((int32_t)(rate - ai_sample_rate) >> ai_sample_rate_filter);
+			ac_set_sample_rate(&ai_ac, ai_sample_rate);
+		}
+		ai_dma_read_count= count;
+		ai_dma_read_time= time;
+
+		//Samples of each input - demultiplexed by the channel tag
+		uint32_t sum[ai_inputs_nr];
+		uint16_t samples[ai_inputs_nr];
+		for(uint8_t i= 0; i < ai_inputs_nr; i++){
+			sum[i]= 0;
+			samples[i]= 0;
+		}
+
+		for(uint16_t s= 0; s < ai_buffer_size; s++){
+			uint16_t sample= ai_dma_buffer[buffer][s];
+			uint8_t input= ai_channel_input[sample >> ai_sample_tag_shift];
+
+			if(input == ai_channel_none)
+				continue;
+			sum[input]+= (sample & ai_sample_mask);
+			samples[input]++;
+
+			//AC measurement - streaming, result on each window
+			if((input == ai_ac_input) && ac_sample(&ai_ac, sample & ai_sample_mask)){
+				_analog_input *ac_input= &analog_inputs[ai_ac_input];
+				ai_ac_voltage= (int32_t)(((int64_t)ai_ac.rms * (ac_input->full_scale - ac_input->offset)) >> (ac_q + ai_sample_bits));
+				ai_ac_time= millis();
+			}
+		}
+
+		//PDC got back to the buffer while decimated - values discarded
+		if(ai_dma_count != count){
+			ai_overruns++;
+			ac_restart(&ai_ac);
+		}
+		else{
+			for(uint8_t i= 0; i < ai_inputs_nr; i++){
+				if(samples[i])
+					analog_inputs[i].raw= (uint16_t)((sum[i] << ai_oversampling_bits) / samples[i]);
+			}
+		}
+	}
+
+	//Engineering values at a fixed rate
+	uint32_t now= millis();
+	if((uint32_t)(now - ai_publish_time) < ai_publish_period)
+		return;
+	ai_publish_time+= ai_publish_period;
+
+	for(uint8_t i= 0; i < ai_inputs_nr; i++){
+		_analog_input *input= &analog_inputs[i];
+		input->value= input->offset + (int32_t)(((int64_t)input->raw * (input->full_scale - input->offset)) / ai_raw_full_scale);
+	}
+	analog_inputs_sync_flag= (1 << ai_inputs_nr) - 1;
 }
 
 
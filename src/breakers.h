@@ -0,0 +1,267 @@
+/*
+ * breakers.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Circuit breakers status - genset controllers and digital inputs
+ */
+
+#ifndef BREAKERS_H_
+#define BREAKERS_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include "genset_modbus.h"
+#include "digital_inputs.h"
+#include "digital_inputs_functions.h"
+#include "sequence_of_events.h"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Circuit breakers - same index of the digital input functions (dif_gcb..dif_mcb)
+static const uint8_t breaker_gcb= 0;	//Genset circuit breaker
+static const uint8_t breaker_mgcb= 1;	//Master genset circuit breaker
+static const uint8_t breaker_mcb= 2;	//Mains circuit breaker
+static const uint8_t breakers_nr= 3;
+
+//Status sources priority
+static const uint8_t breaker_source_modbus= 0x00;		//Genset controllers first, digital input as fallback
+static const uint8_t breaker_source_di= 0x01;			//Digital input first, genset controllers as fallback
+static const uint8_t breaker_source_modbus_only= 0x02;	//Genset controllers only
+static const uint8_t breaker_source_di_only= 0x03;		//Digital input only
+
+//No digital input wired to the breaker auxiliary contact
+static const uint16_t breaker_di_none= 0x0000;
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+//Each breaker status
+typedef struct{
+	//Configuration
+	uint8_t source;			//Status sources priority (breaker_source_*)
+
+	//Resolved status
+	uint8_t status;			//circuit_breaker_opened or circuit_breaker_closed
+	bool valid;				//Status known from some source
+	uint32_t change_time;	//Last transition - sample time of the status source [us]
+	uint16_t transitions;	//Number of transitions
+}_breaker;
+
+_breaker breakers[breakers_nr];
+
+//Transitions not yet handled by the control (bit per breaker)
+//Set on each transition, reset by the consumer
+uint8_t breaker_events;
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the breakers status
+ * ----------------------------------------------------------------*/
+void breakers_init();
+
+/*------------------------------------------------------------------
+ * Set the status sources priority of @breaker and the digital input
+ * wired to its auxiliary contact (@di_mask= breaker_di_none if none)
+ * ----------------------------------------------------------------*/
+void breaker_set_source(uint8_t breaker, uint8_t source, uint16_t di_mask);
+
+/*------------------------------------------------------------------
+ * Status of @breaker read from the connected genset controllers and
+ * the time of the newest response [us] on @sample_time
+ * Return false if no connected controller reported it
+ * ----------------------------------------------------------------*/
+bool breaker_modbus_status(uint8_t breaker, uint8_t *status, uint32_t *sample_time);
+
+/*------------------------------------------------------------------
+ * Status of @breaker from its digital input function and the time of
+ * the last input change [us] on @sample_time
+ * Return false if no digital input is mapped to the breaker
+ * ----------------------------------------------------------------*/
+bool breaker_di_status(uint8_t breaker, uint8_t *status, uint32_t *sample_time);
+
+/*------------------------------------------------------------------
+ * Update the breakers status functions - called from main loop each 1ms
+ * Recalculated only on new controller status or digital input change
+ * ----------------------------------------------------------------*/
+void manage_breakers();
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the breakers status
+ * ----------------------------------------------------------------*/
+void breakers_init(){
+	for(uint8_t i= 0; i < breakers_nr; i++){
+		breakers[i].source= breaker_source_modbus;
+		breakers[i].status= circuit_breaker_opened;
+		breakers[i].valid= false;
+		breakers[i].change_time= 0;
+		breakers[i].transitions= 0;
+	}
+
+	breaker_events= 0;
+}
+
+/*------------------------------------------------------------------
+ * Set the status sources priority of @breaker and the digital input
+ * wired to its auxiliary contact (@di_mask= breaker_di_none if none)
+ * The input is mapped to the breaker function - inverted or combined
+ * inputs are mapped by di_function_set_map
+ * ----------------------------------------------------------------*/
+void breaker_set_source(uint8_t breaker, uint8_t source, uint16_t di_mask){
+	if((breaker >= breakers_nr) || (source > breaker_source_di_only))
+		return;
+
+	breakers[breaker].source= source;
+	di_function_set_map(breaker, di_mask, 0x0000, dif_combine_or);
+
+	//Resolve again with the new sources
+	genset_flag_sync|= genset_sync_breakers;
+}
+
+/*------------------------------------------------------------------
+ * Status of @breaker read from the connected genset controllers and
+ * the time of the newest response [us] on @sample_time
+ * Return false if no connected controller reported it
+ * A breaker closed on any controller is closed (GCB: some genset on bus)
+ * ----------------------------------------------------------------*/
+bool breaker_modbus_status(uint8_t breaker, uint8_t *status, uint32_t *sample_time){
+	bool valid= false;
+	uint32_t now= millis();
+	uint32_t age_min= UINT32_MAX;	//Newest response [ms before now]
+
+	*status= circuit_breaker_opened;
+	for(uint8_t i= 0; i < genset_max_nodes; i++){
+		volatile _genset_node_modbus_data *data= &genset_nodes[i].node_modbus_variables;
+		uint16_t mask= 0x0000;
+
+		//Status never read or node lost
+		if(!(data->sampled_variables & genset_sync_breakers) ||
+		   (genset_nodes[i].node_communication_status == disconnected))
+			continue;
+
+		switch (genset_nodes[i].node_type) {
+			case Sices:
+					if(breaker == breaker_gcb)
+						mask= Sices::gcb_status_mask;
+					else if(breaker == breaker_mgcb)
+						mask= Sices::mgcb_status_mask;
+					else
+						mask= Sices::mcb_status_mask;
+				break;
+			default:
+					continue;
+				break;
+		}
+
+		valid= true;
+		if(data->breakers_status & mask)
+			*status= circuit_breaker_closed;
+		if((uint32_t)(now - data->breakers_time) < age_min)
+			age_min= now - data->breakers_time;
+	}
+
+	//Response time [ms] to the microseconds clock
+	if(valid)
+		*sample_time= micros() - age_min * 1000;
+
+	return(valid);
+}
+
+/*------------------------------------------------------------------
+ * Status of @breaker from its digital input function and the time of
+ * the last input change [us] on @sample_time
+ * Return false if no digital input is mapped to the breaker
+ * ----------------------------------------------------------------*/
+bool breaker_di_status(uint8_t breaker, uint8_t *status, uint32_t *sample_time){
+	if(!di_function_mapped(breaker))
+		return(false);
+
+	*status= (di_function_states & (1 << breaker)) ? circuit_breaker_closed : circuit_breaker_opened;
+	*sample_time= di_change_time;
+	return(true);
+}
+
+/*------------------------------------------------------------------
+ * Update the breakers status functions - called from main loop each 1ms
+ * Recalculated only on new controller status or breaker function event
+ * ----------------------------------------------------------------*/
+void manage_breakers(){
+	if(!(genset_flag_sync & genset_sync_breakers) && !(di_function_events & dif_breakers_mask))
+		return;
+
+	genset_flag_sync&= ~genset_sync_breakers; //Reset flag
+	di_function_events&= ~dif_breakers_mask;
+
+	for(uint8_t i= 0; i < breakers_nr; i++){
+		_breaker *breaker= &breakers[i];
+		uint8_t modbus_status= circuit_breaker_opened;
+		uint8_t di_status= circuit_breaker_opened;
+		uint32_t modbus_time= 0;
+		uint32_t di_time= 0;
+		bool modbus_valid= false;
+		bool di_valid= false;
+
+		if(breaker->source != breaker_source_di_only)
+			modbus_valid= breaker_modbus_status(i, &modbus_status, &modbus_time);
+		if(breaker->source != breaker_source_modbus_only)
+			di_valid= breaker_di_status(i, &di_status, &di_time);
+
+		//Source by priority - the other one only if the first is not available
+		uint8_t status= breaker->status;
+		uint32_t status_time= 0;
+		bool valid= true;
+		if(((breaker->source == breaker_source_modbus) || (breaker->source == breaker_source_modbus_only)) && modbus_valid){
+			status= modbus_status;
+			status_time= modbus_time;
+		}
+		else if(di_valid){
+			status= di_status;
+			status_time= di_time;
+		}
+		else if(modbus_valid){
+			status= modbus_status;
+			status_time= modbus_time;
+		}
+		else
+			valid= false; //Keep the last status
+
+		breaker->valid= valid;
+		if(!valid || (status == breaker->status))
+			continue;
+
+		//Transition - time of the source sample, the mode transition latency
+		//covers the polling of the source
+		breaker->status= status;
+		breaker->change_time= status_time;
+		breaker->transitions++;
+		breaker_events|= (1 << i);
+		soe_record(soe_breaker_change, i, status, breaker->change_time);
+
+		switch(i){
+			case breaker_gcb:
+				di_functions.dif_gcb_status= status;
+				break;
+			case breaker_mgcb:
+				di_functions.dif_mgcb_status= status;
+				break;
+			case breaker_mcb:
+				di_functions.dif_mcb_status= status;
+				break;
+		}
+	}
+}
+
+
+#endif /* BREAKERS_H_ */
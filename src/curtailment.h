@@ -0,0 +1,322 @@
+/*
+ * curtailment.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      PV curtailment - keep the gensets above the minimum load
+ */
+
+#ifndef CURTAILMENT_H_
+#define CURTAILMENT_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include "pv_modbus.h"
+#include "genset_modbus.h"
+#include "digital_inputs_functions.h"
+#include "pi_controller.h"
+#include "ramp_limiter.h"
+#include "dispatcher.h"
+#include "analog_inputs.h"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Control task period
+static const uint16_t curtailment_period= 100; //100ms
+
+//Default gensets minimum load [0.1% of genset_nominal_power_total]
+static const uint16_t curtailment_min_load_default= 300; //30.0%
+
+//Default PI tuning [Q16]
+static const int32_t curtailment_kp_default= 13107;	//0.20
+static const int32_t curtailment_ki_default= 26214;	//0.40 per new genset measurement
+static const int32_t curtailment_kff_default= -65536;	//-1.00 feed-forward: PV power change taken off the limit (test/pi_bench)
+
+//Default genset governor droop [0.1% of the bus frequency, no load to full load]
+//Bus frequency change read as genset power change between measurements (0= isochronous, not used)
+static const uint16_t curtailment_droop_default= 40; //4.0%
+
+//Default PI output rate limit [0.1% of pv_nominal_power_total per period]
+static const uint16_t curtailment_rate_max_default= 50; //5.0%
+
+//Default PV limit ramp rates between the control and the dispatcher [kW/s]
+//Decreases are limited in grid tied mode only - in island mode the PV cut
+//keeps the gensets off reverse power and is never delayed
+static const uint16_t curtailment_ramp_up_default= 25;
+static const uint16_t curtailment_ramp_down_default= 50;
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+//Gensets minimum load [0.1% of genset_nominal_power_total]
+uint16_t curtailment_min_load;
+
+//PV system limit [W] - maximum PV power keeping the gensets above the minimum load
+int32_t curtailment_pv_limit;
+
+//PV system limit dispatched to the inverters [0.1% of pv_nominal_power_total]
+uint16_t curtailment_pv_limit_percent;
+
+//Genset power regulator - output is the PV limit [W]
+_pi_controller curtailment_pi;
+//PI output rate limit [0.1% of pv_nominal_power_total per period]
+uint16_t curtailment_rate_max;
+//Regulator running (bumpless start from the actual PV power)
+bool curtailment_running;
+
+//PV limit ramp rate limiter - output is the PV limit dispatched [W]
+_ramp_limiter curtailment_ramp;
+uint32_t curtailment_ramp_time;	//Last ramp step [ms]
+
+//Bus frequency - fast inner signal between genset measurements
+uint16_t curtailment_droop;					//Genset governor droop [0.1%] (0= not used)
+uint32_t curtailment_frequency_ref;			//Bus frequency on the last genset measurement [mHz] (0= none)
+
+//PV limitation disabled by digital input - updated on the dif_power_limit event
+bool curtailment_limit_disabled;
+
+//Feed-forward and new measurement detection
+int32_t curtailment_prev_pv_active;		//PV active power on previous period [W]
+uint32_t curtailment_genset_sample_time;	//Newest genset sample used on previous period [ms]
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the curtailment control
+ * ----------------------------------------------------------------*/
+void curtailment_init();
+
+/*------------------------------------------------------------------
+ * Set the gensets minimum load [0.1% of genset_nominal_power_total]
+ * ----------------------------------------------------------------*/
+void curtailment_set_min_load(uint16_t min_load);
+
+/*------------------------------------------------------------------
+ * Set the PI gains [Q16] - integral gain per new genset measurement
+ * ----------------------------------------------------------------*/
+void curtailment_set_gains(int32_t kp, int32_t ki, int32_t kff);
+
+/*------------------------------------------------------------------
+ * Set the PV limit ramp rates [kW/s] (0= no limit)
+ * ----------------------------------------------------------------*/
+void curtailment_set_ramp(uint16_t ramp_up, uint16_t ramp_down);
+
+/*------------------------------------------------------------------
+ * Set the genset governor droop [0.1%] (0= bus frequency not used)
+ * ----------------------------------------------------------------*/
+void curtailment_set_droop(uint16_t droop);
+
+/*------------------------------------------------------------------
+ * Power limitation input - consume the dif_power_limit event
+ * Return true while the PV limitation is disabled by digital input
+ * ----------------------------------------------------------------*/
+bool curtailment_limit_input();
+
+/*------------------------------------------------------------------
+ * Ramp rate limit of the PV @limit [W] - called once per control period
+ * The setpoint latency measured on the PV bus is taken into account
+ * @limit_decrease= false lets decreases through without ramp
+ * Return the PV limit to be dispatched [W]
+ * ----------------------------------------------------------------*/
+int32_t curtailment_ramp_limit(int32_t limit, bool limit_decrease);
+
+/*------------------------------------------------------------------
+ * Control task - called from main loop each curtailment_period
+ * Compute the PV limit and dispatch it to the inverters
+ * ----------------------------------------------------------------*/
+void manage_curtailment();
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the curtailment control
+ * ----------------------------------------------------------------*/
+void curtailment_init(){
+	curtailment_min_load= curtailment_min_load_default;
+	curtailment_pv_limit= 0;
+	curtailment_pv_limit_percent= pv_power_limit_max;
+
+	pi_init(&curtailment_pi, curtailment_kp_default, curtailment_ki_default, curtailment_kff_default, 0, 0, 0);
+	curtailment_rate_max= curtailment_rate_max_default;
+	curtailment_running= false;
+	ramp_init(&curtailment_ramp, (int32_t)curtailment_ramp_up_default * 1000, (int32_t)curtailment_ramp_down_default * 1000, 0);
+	curtailment_ramp_time= 0;
+	curtailment_droop= curtailment_droop_default;
+	curtailment_frequency_ref= 0;
+	curtailment_limit_disabled= false;
+	curtailment_prev_pv_active= 0;
+	curtailment_genset_sample_time= 0;
+}
+
+/*------------------------------------------------------------------
+ * Set the gensets minimum load [0.1% of genset_nominal_power_total]
+ * ----------------------------------------------------------------*/
+void curtailment_set_min_load(uint16_t min_load){
+	if(min_load > 1000)
+		min_load= 1000;
+
+	curtailment_min_load= min_load;
+}
+
+/*------------------------------------------------------------------
+ * Set the PI gains [Q16] - integral gain per new genset measurement
+ * ----------------------------------------------------------------*/
+void curtailment_set_gains(int32_t kp, int32_t ki, int32_t kff){
+	curtailment_pi.kp= kp;
+	curtailment_pi.ki= ki;
+	curtailment_pi.kff= kff;
+}
+
+/*------------------------------------------------------------------
+ * Set the PV limit ramp rates [kW/s] (0= no limit)
+ * ----------------------------------------------------------------*/
+void curtailment_set_ramp(uint16_t ramp_up, uint16_t ramp_down){
+	curtailment_ramp.rate_up= (int32_t)ramp_up * 1000;
+	curtailment_ramp.rate_down= (int32_t)ramp_down * 1000;
+}
+
+/*------------------------------------------------------------------
+ * Set the genset governor droop [0.1%] (0= bus frequency not used)
+ * ----------------------------------------------------------------*/
+void curtailment_set_droop(uint16_t droop){
+	curtailment_droop= droop;
+}
+
+/*------------------------------------------------------------------
+ * Power limitation input - consume the dif_power_limit event
+ * Return true while the PV limitation is disabled by digital input
+ * ----------------------------------------------------------------*/
+bool curtailment_limit_input(){
+	if(di_function_events & (1 << dif_power_limit)){
+		di_function_events&= ~(1 << dif_power_limit); //Reset event
+		curtailment_limit_disabled= (di_functions.dif_disable_power_limit == power_limit_disabled);
+	}
+
+	return(curtailment_limit_disabled);
+}
+
+/*------------------------------------------------------------------
+ * Ramp rate limit of the PV @limit [W] - called once per control period
+ * The setpoint latency measured on the PV bus is taken into account
+ * @limit_decrease= false lets decreases through without ramp
+ * Return the PV limit to be dispatched [W]
+ * ----------------------------------------------------------------*/
+int32_t curtailment_ramp_limit(int32_t limit, bool limit_decrease){
+	uint32_t now= millis();
+
+	//Time since the last step - nominal period after a pause
+	uint32_t period= now - curtailment_ramp_time;
+	if((curtailment_ramp_time == 0) || (period > (4 * (uint32_t)curtailment_period)))
+		period= curtailment_period;
+	curtailment_ramp_time= now;
+
+	//Decrease not limited - the ramp restarts from the new limit
+	if(!limit_decrease && (((int64_t)limit << ramp_q) < curtailment_ramp.output)){
+		ramp_reset(&curtailment_ramp, limit);
+		return(limit);
+	}
+
+	//New limit reaches the inverters only after the setpoint latency - the
+	//ramp is referred to the limit they acknowledged
+	uint32_t latency= pv_setpoint_latency.last;
+	if(latency > pv_setpoint_latency.bound)
+		latency= pv_setpoint_latency.bound;
+
+	return(ramp_update(&curtailment_ramp, limit, dispatcher_acknowledged_limit(), period, latency));
+}
+
+/*------------------------------------------------------------------
+ * Control task - called from main loop each curtailment_period
+ * Compute the PV limit and dispatch it to the inverters
+ * ----------------------------------------------------------------*/
+void manage_curtailment(){
+	uint16_t limit_percent= pv_power_limit_max;
+
+	//No genset or PV values to control - keep the last limit
+	if((genset_active_power_status.contributors == 0) || (pv_nominal_power_total <= 0))
+		return;
+
+	//Gensets minimum load [W]
+	int32_t genset_min_load= (int32_t)(((int64_t)genset_nominal_power_total * curtailment_min_load) / 1000);
+
+	//Output range follows the PV nominal power
+	pi_set_limits(&curtailment_pi, 0, pv_nominal_power_total);
+	curtailment_pi.rate_max= (int32_t)(((int64_t)pv_nominal_power_total * curtailment_rate_max) / 1000);
+
+	//Bumpless start from the actual PV power
+	if(!curtailment_running){
+		pi_reset(&curtailment_pi, pv_active_power_total);
+		ramp_reset(&curtailment_ramp, pv_active_power_total);
+		curtailment_prev_pv_active= pv_active_power_total;
+		curtailment_running= true;
+	}
+
+	//Genset power above the minimum load can be taken over by PV
+	//Gensets below the minimum load - PV must be reduced
+	int32_t error= genset_active_power_total - genset_min_load;
+
+	//Feed-forward - PV power change since the previous period
+	int32_t pv_change= pv_active_power_total - curtailment_prev_pv_active;
+	curtailment_prev_pv_active= pv_active_power_total;
+
+	//Integrate only new genset measurements
+	bool new_measurement= (genset_active_power_status.newest_time != curtailment_genset_sample_time);
+	curtailment_genset_sample_time= genset_active_power_status.newest_time;
+
+	//Bus frequency - genset power change since the last measurement, far
+	//ahead of the next Modbus sample. Droop: the frequency falls by droop
+	//of the bus frequency from no load to full load, a rise of frequency
+	//over the reference is a fall of genset_nominal_power_total / droop
+	if(new_measurement)
+		curtailment_frequency_ref= ai_ac.valid ? ai_ac.frequency : 0;
+	if((curtailment_droop != 0) && ai_ac.valid && (curtailment_frequency_ref != 0)){
+		int64_t frequency_change= (int32_t)ai_ac.frequency - (int32_t)curtailment_frequency_ref;
+		error-= (int32_t)(((int64_t)genset_nominal_power_total * frequency_change * 1000) /
+						  ((int64_t)curtailment_droop * curtailment_frequency_ref));
+	}
+
+	//Gensets above the minimum load by less than the dispatcher deadband - the
+	//limit change would not be written, integrating it only builds a limit
+	//cycle around the deadband
+	int32_t error_deadband= (int32_t)(((int64_t)pv_nominal_power_total * dispatcher_deadband) / 1000);
+	if((error >= 0) && (error <= error_deadband))
+		new_measurement= false;
+
+	curtailment_pv_limit= pi_update(&curtailment_pi, error, pv_change, new_measurement);
+
+	int32_t dispatch_limit= curtailment_pv_limit;
+	bool limit_disabled= false;
+
+	//Power limitation disabled by digital input
+	if(curtailment_limit_input()){
+		dispatch_limit= pv_nominal_power_total;
+		limit_disabled= true;
+	}
+
+	//Ramp rate limit of the increases only (island) - the regulator follows
+	//the ramp (no windup while it holds)
+	dispatch_limit= curtailment_ramp_limit(dispatch_limit, false);
+	if(curtailment_ramp.limited && !limit_disabled){
+		pi_reset(&curtailment_pi, dispatch_limit);
+		curtailment_pv_limit= dispatch_limit;
+	}
+
+	//Limit in 0.1% of PV nominal power
+	limit_percent= (uint16_t)(((int64_t)dispatch_limit * pv_power_limit_max) / pv_nominal_power_total);
+	curtailment_pv_limit_percent= limit_percent;
+
+	//Share among the nodes - only setpoints out of the deadband are written
+	dispatch_pv_limit(dispatch_limit, genset_active_power_status.newest_time);
+}
+
+
+#endif /* CURTAILMENT_H_ */
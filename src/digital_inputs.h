@@ -13,6 +13,7 @@
  * ----------------------------------------------------------------*/
 #include "hal/board.h"
 #include "digital_inputs_functions.h"
+#include "sequence_of_events.h"
 
 
 /*------------------------------------------------------------------
@@ -26,6 +27,13 @@ const uint16_t di_02= 0x0002; //Digital input 02= bit 02
 const uint16_t di_03= 0x0004; //Digital input 03= bit 03
 const uint16_t di_04= 0x0008; //Digital input 04= bit 04
 
+/**
+ * Hardware pin of each digital input (bit order of the masks above)
+ * All inputs must be on the same PIO port - sampled in one read
+ */
+const uint8_t di_pins[]= {digital_input1, digital_input2, digital_input3, digital_input4};
+const uint8_t di_inputs_nr= sizeof(di_pins) / sizeof(di_pins[0]);
+
 /**
  * Define the logic levels used for digital inputs
  */
@@ -34,11 +42,13 @@ const uint8_t di_deactivated= HIGH;
 
 /**
  * Software filter for digital inputs.
- * Minimum time between to interrupts.
+ * The port is sampled each di_sample_period and a level must be stable
+ * on 4 consecutive samples (vertical counter) to change the input state.
  * This time define the MINIMUM time that some DI need to be activated to
  * activate the respective function.
  */
-const uint16_t di_filter_time= 100; //100ms
+const uint8_t di_sample_period= 5; //5ms - filter time 20ms
+const uint8_t di_filter_samples= 4; //Samples to change the input state
 
 //Used as default value to signal that no synchronization is necessary
 const uint16_t di_sync_none= 0x0000;
@@ -56,15 +66,25 @@ volatile uint16_t di_logical_states;
 
 //Save the hardware status (after filter) of each digital input
 volatile uint16_t di_physical_states;
+//Last change of di_physical_states - first sample with the new level [us]
+volatile uint32_t di_change_time;
 
 //Save the logic used to set the logic status of each digital input function
 //Bit= 0; Normal logic, logical state = physical state
 //Bit= 1; Reverse logic, logical state = ~physical state
 uint16_t di_logic_selection;
 
-//Synchronization flag
+//Synchronization flag - inputs changed since the last management (bit per input)
 volatile uint16_t digital_inputs_sync_flag;
 
+//Port sampling and vertical counter debounce (bit per port line)
+Pio *di_port;				//PIO port of the digital inputs
+uint32_t di_port_mask;		//Port lines used as digital inputs
+uint32_t di_port_lines[di_inputs_nr]; //Port line of each digital input
+uint32_t di_port_states;	//Debounced port lines (1= activated)
+uint32_t di_counter_0;		//Vertical counter - bit 0
+uint32_t di_counter_1;		//Vertical counter - bit 1
+
 /*------------------------------------------------------------------
  * 					PROTOTYPES
  * ----------------------------------------------------------------*/
@@ -74,36 +94,17 @@ volatile uint16_t digital_inputs_sync_flag;
 void init_digital_inputs();
 
 /*------------------------------------------------------------------
- * Manage the digital inputs logic and physical status.
- * Function called from main loop when the synchronization flag is set
- * ----------------------------------------------------------------*/
-void manage_digital_inputs();
-
-/*------------------------------------------------------------------
- * Manage the physical and logical status of each digital input
- * @digital_input is the hardware pin number used as digital input
- * ----------------------------------------------------------------*/
-void di_change_detect(uint8_t digital_input);
-
-/*------------------------------------------------------------------
- * ISR - Digital input 1 activated
- * ----------------------------------------------------------------*/
-void di_1_activated();
-
-/*------------------------------------------------------------------
- * ISR - Digital input 2 activated
- * ----------------------------------------------------------------*/
-void di_2_activated();
-
-/*------------------------------------------------------------------
- * ISR - Digital input 3 activated
+ * Sample all digital inputs in one port read and debounce them -
+ * called from main loop each di_sample_period
+ * The inputs changed are signaled on digital_inputs_sync_flag
  * ----------------------------------------------------------------*/
-void di_3_activated();
+void di_sample_inputs();
 
 /*------------------------------------------------------------------
- * ISR - Digital input 4 activated
+ * Manage the digital inputs logic and physical status.
+ * Function called from main loop when the synchronization flag is set
  * ----------------------------------------------------------------*/
-void di_4_activated();
+void manage_digital_inputs();
 
 
  /*------------------------------------------------------------------
@@ -113,162 +114,96 @@ void di_4_activated();
  * Initialize the hardware
  * ----------------------------------------------------------------*/
 void init_digital_inputs(){
-	pinMode(digital_input1, INPUT);
-	attachInterrupt(digitalPinToInterrupt(digital_input1), di_1_activated, CHANGE);
-	pinMode(digital_input2, INPUT);
-	attachInterrupt(digitalPinToInterrupt(digital_input2), di_2_activated, CHANGE);
-	pinMode(digital_input3, INPUT);
-	attachInterrupt(digitalPinToInterrupt(digital_input3), di_3_activated, CHANGE);
-	pinMode(digital_input4, INPUT);
-	attachInterrupt(digitalPinToInterrupt(digital_input1), di_4_activated, CHANGE);
+	di_port= g_APinDescription[di_pins[0]].pPort;
+	di_port_mask= 0x00000000;
+
+	for(uint8_t i= 0; i < di_inputs_nr; i++){
+		pinMode(di_pins[i], INPUT);
+
+		//Inputs out of the sampled port are not managed
+		di_port_lines[i]= 0x00000000;
+		if(g_APinDescription[di_pins[i]].pPort == di_port)
+			di_port_lines[i]= g_APinDescription[di_pins[i]].ulPin;
+		di_port_mask|= di_port_lines[i];
+	}
 
 	//All deactivated
 	di_physical_states= 0x0000;
+	di_change_time= 0;
 	di_logical_states= 0x0000;
 	//Normal logic
 	di_logic_selection= 0x0000;
 
+	//Debounce starts from the deactivated state
+	di_port_states= 0x00000000;
+	di_counter_0= 0x00000000;
+	di_counter_1= 0x00000000;
+
 	//Reset synchronization flag
 	digital_inputs_sync_flag= di_sync_none;
 }
 
 /*------------------------------------------------------------------
- * Manage the digital inputs logic and physical status.
- * Function called from main loop when the synchronization flag is set
+ * Sample all digital inputs in one port read and debounce them -
+ * called from main loop each di_sample_period
+ * Vertical counter: each port line has a 2 bit counter spread over
+ * di_counter_1:di_counter_0, reset while the sample equals the state;
+ * the state toggles when the counter wraps (di_filter_samples different)
+ * The inputs changed are signaled on digital_inputs_sync_flag
  * ----------------------------------------------------------------*/
-void manage_digital_inputs(){
-	//Verifies the physical states
-	if(digital_inputs_sync_flag & di_01){
-		di_change_detect(digital_input1);
-	}
-	if(digital_inputs_sync_flag & di_02){
-		di_change_detect(digital_input2);
-	}
-	if(digital_inputs_sync_flag & di_03){
-		di_change_detect(digital_input3);
-	}
-	if(digital_inputs_sync_flag & di_04){
-		di_change_detect(digital_input4);
-	}
+void di_sample_inputs(){
+	//Activated lines (inputs activated at LOW level)
+	uint32_t sample= ~di_port->PIO_PDSR & di_port_mask;
 
-	//Save previous states
-	uint16_t prev_logical_states= di_logical_states;
+	uint32_t delta= sample ^ di_port_states;
+	di_counter_1= (di_counter_1 ^ di_counter_0) & delta;
+	di_counter_0= ~di_counter_0 & delta;
+	uint32_t toggle= delta & ~(di_counter_0 | di_counter_1);
+	di_port_states^= toggle;
 
-	//Verifies the logical state based on physical state and logic selection.
-	//XOR operation do exactly the logic used to set the logic states based on physical states.
-	di_logical_states= di_physical_states ^ di_logic_selection;
-
-	//Manage the functions associated with the digital inputs
-	if(prev_logical_states != di_logical_states){
+	if(!toggle)
+		return;
 
+	//Port lines to digital input bits - only on changes
+	uint16_t physical_states= 0x0000;
+	for(uint8_t i= 0; i < di_inputs_nr; i++){
+		if(di_port_states & di_port_lines[i])
+			physical_states|= (1 << i);
 	}
 
-}
-
-/*------------------------------------------------------------------
- * Manage the physical status of each digital input
- * @digital_input is the hardware pin number used as digital input
- * ----------------------------------------------------------------*/
-void di_change_detect(uint8_t digital_input){
-	//Read the state of digital input
-	uint8_t level= digitalRead(digital_input);
-
-	//Verifies the physical state
-	switch(digital_input){
-		//Set reset physical states
-		case digital_input1:
-			level == di_activated ?	di_physical_states|= di_01 : di_physical_states&= ~di_01;
-		break;
-		case digital_input2:
-			level == di_activated ? di_physical_states|= di_02 : di_physical_states&= ~di_02;
-		break;
-		case digital_input3:
-			level == di_activated ? di_physical_states|= di_03 : di_physical_states&= ~di_03;
-		break;
-		case digital_input4:
-			level == di_activated ? di_physical_states|= di_04 : di_physical_states&= ~di_04;
-		break;
+	//Sequence of events - time of the first sample with the new level
+	uint16_t changes= physical_states ^ di_physical_states;
+	uint32_t change_time= micros() - (uint32_t)(di_filter_samples - 1) * di_sample_period * 1000;
+	for(uint8_t i= 0; i < di_inputs_nr; i++){
+		if(changes & (1 << i))
+			soe_record(soe_di_change, i, (physical_states >> i) & 0x0001, change_time);
 	}
-}
 
-/*------------------------------------------------------------------
- * ISR - Digital input 1 activated
- * Digital inputs with software filter
- * ----------------------------------------------------------------*/
-void di_1_activated(){
-	static uint32_t last_interrupt_time= 0;
-	uint32_t interrupt_time= millis();
-
-	//Filter - the signal on input must be stable at least
-	//di_filter_time milliseconds to trigger the function.
-	if((interrupt_time - last_interrupt_time) >= di_filter_time){
-		//Set status to manage the digital input 1
-		digital_inputs_sync_flag|= di_01;
-
-		//Reset time to next trigger
-		last_interrupt_time= millis();
-	}
+	digital_inputs_sync_flag|= changes;
+	di_physical_states= physical_states;
+	di_change_time= change_time;
 }
 
 /*------------------------------------------------------------------
- * ISR - Digital input 2 activated
- * Digital inputs with software filter
+ * Manage the digital inputs logic and physical status.
+ * Function called from main loop when the synchronization flag is set
  * ----------------------------------------------------------------*/
-void di_2_activated(){
-	static uint32_t last_interrupt_time= 0;
-	uint32_t interrupt_time= millis();
-
-	//Filter - the signal on input must be stable at least
-	//di_filter_time milliseconds to trigger the function.
-	if((interrupt_time - last_interrupt_time) >= di_filter_time){
-		//Set status to manage the digital input 2
-		digital_inputs_sync_flag|= di_02;
-
-		//Reset time to next trigger
-		last_interrupt_time= millis();
-	}
-}
+void manage_digital_inputs(){
+	digital_inputs_sync_flag= di_sync_none; //Reset flag
 
-/*------------------------------------------------------------------
- * ISR - Digital input 3 activated
- * Digital inputs with software filter
- * ----------------------------------------------------------------*/
-void di_3_activated(){
-	static uint32_t last_interrupt_time= 0;
-	uint32_t interrupt_time= millis();
-
-	//Filter - the signal on input must be stable at least
-	//di_filter_time milliseconds to trigger the function.
-	if((interrupt_time - last_interrupt_time) >= di_filter_time){
-		//Set status to manage the digital input 3
-		digital_inputs_sync_flag|= di_03;
-
-		//Reset time to next trigger
-		last_interrupt_time= millis();
-	}
-}
+	//Save previous states
+	uint16_t prev_logical_states= di_logical_states;
 
-/*------------------------------------------------------------------
- * ISR - Digital input 4 activated
- * Digital inputs with software filter
- * ----------------------------------------------------------------*/
-void di_4_activated(){
-	static uint32_t last_interrupt_time= 0;
-	uint32_t interrupt_time= millis();
-
-	//Filter - the signal on input must be stable at least
-	//di_filter_time milliseconds to trigger the function.
-	if((interrupt_time - last_interrupt_time) >= di_filter_time){
-		//Set status to manage the digital input 4
-		digital_inputs_sync_flag|= di_04;
-
-		//Reset time to next trigger
-		last_interrupt_time= millis();
+	//Verifies the logical state based on physical state and logic selection.
+	//XOR operation do exactly the logic used to set the logic states based on physical states.
+	di_logical_states= di_physical_states ^ di_logic_selection;
+
+	//Manage the functions associated with the digital inputs
+	//Changes signaled to the consumers on di_function_events
+	if(prev_logical_states != di_logical_states){
+		di_functions_evaluate(di_logical_states);
 	}
 }
 
 
-
-
-
 #endif /* DIGITAL_INPUTS_H_ */
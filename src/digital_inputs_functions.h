@@ -25,6 +25,30 @@ const uint8_t circuit_breaker_closed= 0x01;
 const uint8_t power_limit_enabled= 0x00;
 const uint8_t power_limit_disabled= 0x01;
 
+//Status of bits for external protection trips
+const uint8_t external_trip_inactive= 0x00;
+const uint8_t external_trip_active= 0x01;
+
+//--------------DIGITAL INPUT FUNCTIONS INDEX-----------------------
+//Bit of each function on the mapping, states and events
+//Breakers functions on the breakers index order (breakers.h)
+static const uint8_t dif_gcb= 0;
+static const uint8_t dif_mgcb= 1;
+static const uint8_t dif_mcb= 2;
+static const uint8_t dif_power_limit= 3;
+static const uint8_t dif_reverse_power= 4;
+static const uint8_t dif_functions_nr= 5;
+
+//Functions resolved by the breakers (digital input is one of the sources)
+static const uint8_t dif_breakers_mask= (1 << dif_gcb) | (1 << dif_mgcb) | (1 << dif_mcb);
+
+//Combination of the inputs mapped to a function
+static const uint8_t dif_combine_or= 0x00;	//Active with any input active
+static const uint8_t dif_combine_and= 0x01;	//Active with all inputs active
+
+//No input mapped to the function
+static const uint16_t dif_inputs_none= 0x0000;
+
 /*------------------------------------------------------------------
  * 					GLOBAL VARIABLES
  * ----------------------------------------------------------------*/
@@ -44,8 +68,35 @@ struct{
 	//---------- Logic management functions
 	//Disable the power limitation for PV system
 	uint8_t dif_disable_power_limit: 1;
+
+	//---------- Protection functions
+	//External reverse power relay - trip the PV curtailment
+	uint8_t dif_reverse_power_trip: 1;
 } di_functions;
 
+/**
+ * Mapping of the digital inputs to each function
+ *-->The inputs (logical states) are inverted by @inverted and combined by
+ *   @combine - all functions evaluated with bit masks on each input change
+ */
+typedef struct{
+	uint16_t inputs;		//Inputs of the function (di_01..di_04, dif_inputs_none: not mapped)
+	uint16_t inverted;		//Inputs inverted for this function
+	uint8_t combine;		//dif_combine_or or dif_combine_and
+}_di_function_map;
+
+_di_function_map di_function_map[dif_functions_nr];
+
+//Functions states from the digital inputs (bit per function)
+uint8_t di_function_states;
+
+//Inputs logical states of the last evaluation
+uint16_t di_function_inputs;
+
+//Functions changed not yet handled by the consumers (bit per function)
+//Set on each change, reset by the consumer of the function
+uint8_t di_function_events;
+
 
 /*------------------------------------------------------------------
  * 					PROTOTYPES
@@ -55,6 +106,23 @@ struct{
  * ----------------------------------------------------------------*/
 void di_functions_init();
 
+/*------------------------------------------------------------------
+ * Map @inputs to @function - @inverted inputs, combined by @combine
+ * (@inputs= dif_inputs_none to unmap the function)
+ * ----------------------------------------------------------------*/
+void di_function_set_map(uint8_t function, uint16_t inputs, uint16_t inverted, uint8_t combine);
+
+/*------------------------------------------------------------------
+ * Function mapped to some digital input
+ * ----------------------------------------------------------------*/
+bool di_function_mapped(uint8_t function);
+
+/*------------------------------------------------------------------
+ * Evaluate all functions from the inputs @logical_states - called on
+ * each input change. Return the functions changed (bit per function)
+ * ----------------------------------------------------------------*/
+uint8_t di_functions_evaluate(uint16_t logical_states);
+
 
  /*------------------------------------------------------------------
  * 					FUNCTIONS DEFINITION
@@ -70,6 +138,80 @@ void di_functions_init(){
 
 	//Power limit enabled
 	di_functions.dif_disable_power_limit= power_limit_enabled;
+
+	//No external trip
+	di_functions.dif_reverse_power_trip= external_trip_inactive;
+
+	//No input mapped
+	for(uint8_t i= 0; i < dif_functions_nr; i++){
+		di_function_map[i].inputs= dif_inputs_none;
+		di_function_map[i].inverted= 0x0000;
+		di_function_map[i].combine= dif_combine_or;
+	}
+	di_function_states= 0x00;
+	di_function_inputs= 0x0000;
+	di_function_events= 0x00;
+}
+
+/*------------------------------------------------------------------
+ * Map @inputs to @function - @inverted inputs, combined by @combine
+ * (@inputs= dif_inputs_none to unmap the function)
+ * The functions are evaluated again on the last inputs states
+ * ----------------------------------------------------------------*/
+void di_function_set_map(uint8_t function, uint16_t inputs, uint16_t inverted, uint8_t combine){
+	if((function >= dif_functions_nr) || (combine > dif_combine_and))
+		return;
+
+	di_function_map[function].inputs= inputs;
+	di_function_map[function].inverted= inverted & inputs;
+	di_function_map[function].combine= combine;
+
+	//Consumers resolve the function again (mapping changed)
+	di_function_events|= (1 << function);
+	di_functions_evaluate(di_function_inputs);
+}
+
+/*------------------------------------------------------------------
+ * Function mapped to some digital input
+ * ----------------------------------------------------------------*/
+bool di_function_mapped(uint8_t function){
+	return((function < dif_functions_nr) && (di_function_map[function].inputs != dif_inputs_none));
+}
+
+/*------------------------------------------------------------------
+ * Evaluate all functions from the inputs @logical_states - called on
+ * each input change. Return the functions changed (bit per function)
+ * Functions not mapped are kept inactive. The changes are signaled on
+ * di_function_events; the breakers functions are resolved by the
+ * breakers (other sources), the others are set here
+ * ----------------------------------------------------------------*/
+uint8_t di_functions_evaluate(uint16_t logical_states){
+	uint8_t states= 0x00;
+
+	for(uint8_t i= 0; i < dif_functions_nr; i++){
+		const _di_function_map *map= &di_function_map[i];
+		uint16_t active= (logical_states ^ map->inverted) & map->inputs;
+
+		if(map->combine == dif_combine_and){
+			if((map->inputs != dif_inputs_none) && (active == map->inputs))
+				states|= (1 << i);
+		}
+		else if(active){
+			states|= (1 << i);
+		}
+	}
+
+	uint8_t changes= states ^ di_function_states;
+	di_function_states= states;
+	di_function_inputs= logical_states;
+	di_function_events|= changes;
+
+	if(changes & (1 << dif_power_limit))
+		di_functions.dif_disable_power_limit= (states & (1 << dif_power_limit)) ? power_limit_disabled : power_limit_enabled;
+	if(changes & (1 << dif_reverse_power))
+		di_functions.dif_reverse_power_trip= (states & (1 << dif_reverse_power)) ? external_trip_active : external_trip_inactive;
+
+	return(changes);
 }
 
 
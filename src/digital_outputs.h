@@ -17,11 +17,54 @@
 /*------------------------------------------------------------------
  * 					GLOBAL CONSTANTS
  * ----------------------------------------------------------------*/
+/**
+ * Mask used to manage the digital outputs bits
+ */
+const uint16_t do_01= 0x0001; //Digital output 01= bit 01
+const uint16_t do_02= 0x0002; //Digital output 02= bit 02
+const uint16_t do_03= 0x0004; //Digital output 03= bit 03
+const uint16_t do_04= 0x0008; //Digital output 04= bit 04
+
+/**
+ * Hardware pin of each digital output (bit order of the masks above)
+ * Outputs may be on different PIO ports - one write per port
+ */
+const uint8_t do_pins[]= {digital_output1, digital_output2, digital_output3, digital_output4};
+const uint8_t do_outputs_nr= sizeof(do_pins) / sizeof(do_pins[0]);
+
+//No minimum on/off time
+const uint16_t do_min_time_none= 0;
 
 
 /*------------------------------------------------------------------
  * 					GLOBAL VARIABLES
  * ----------------------------------------------------------------*/
+/**
+ * Shadow of the outputs requested by the program logic (1= activated)
+ *-->Changed by do_set, do_clear, do_write and do_pulse
+ *-->Applied to the ports by manage_digital_outputs
+ */
+uint16_t do_shadow;
+
+//States applied to the ports (1= activated)
+uint16_t do_states;
+
+//Each output configuration and timing
+typedef struct{
+	uint16_t min_on_time;		//Minimum time activated [ms]
+	uint16_t min_off_time;		//Minimum time deactivated [ms]
+	uint32_t change_time;		//Last change applied to the port [ms]
+	uint32_t pulse_time;		//Pulse started [ms]
+	uint16_t pulse_duration;	//Pulse duration [ms] (0= no pulse running)
+}_digital_output;
+
+_digital_output digital_outputs[do_outputs_nr];
+
+//Ports of the outputs - changes written with one set and one clear per port
+Pio *do_ports[do_outputs_nr];				//Distinct PIO ports used
+uint8_t do_ports_nr;
+uint8_t do_port_index[do_outputs_nr];		//Port of each output (index on do_ports)
+uint32_t do_port_lines[do_outputs_nr];		//Port line of each output
 
 
 /*------------------------------------------------------------------
@@ -32,6 +75,37 @@
  * ----------------------------------------------------------------*/
 void init_digital_outputs();
 
+/*------------------------------------------------------------------
+ * Set the minimum time [ms] activated and deactivated of @output
+ * (genset start/stop relays)
+ * ----------------------------------------------------------------*/
+void do_set_min_times(uint8_t output, uint16_t min_on_time, uint16_t min_off_time);
+
+/*------------------------------------------------------------------
+ * Activate the outputs of @mask
+ * ----------------------------------------------------------------*/
+void do_set(uint16_t mask);
+
+/*------------------------------------------------------------------
+ * Deactivate the outputs of @mask
+ * ----------------------------------------------------------------*/
+void do_clear(uint16_t mask);
+
+/*------------------------------------------------------------------
+ * Write @states to the outputs of @mask
+ * ----------------------------------------------------------------*/
+void do_write(uint16_t mask, uint16_t states);
+
+/*------------------------------------------------------------------
+ * Activate the outputs of @mask for @duration [ms]
+ * ----------------------------------------------------------------*/
+void do_pulse(uint16_t mask, uint16_t duration);
+
+/*------------------------------------------------------------------
+ * Apply the shadow to the ports - called from main loop each 1ms
+ * ----------------------------------------------------------------*/
+void manage_digital_outputs();
+
 
  /*------------------------------------------------------------------
  * 					FUNCTIONS DEFINITION
@@ -40,14 +114,155 @@ void init_digital_outputs();
  * Initialize the hardware
  * ----------------------------------------------------------------*/
 void init_digital_outputs(){
-	pinMode(digital_output1, OUTPUT);
-	digitalWrite(digital_output1, 0);
-	pinMode(digital_output2, OUTPUT);
-	digitalWrite(digital_output2, 0);
-	pinMode(digital_output3, OUTPUT);
-	digitalWrite(digital_output3, 0);
-	pinMode(digital_output4, OUTPUT);
-	digitalWrite(digital_output4, 0);
+	do_ports_nr= 0;
+
+	for(uint8_t i= 0; i < do_outputs_nr; i++){
+		pinMode(do_pins[i], OUTPUT);
+		digitalWrite(do_pins[i], 0);
+
+		//Port of the output - new ports are added to the table
+		Pio *port= g_APinDescription[do_pins[i]].pPort;
+		uint8_t p= 0;
+		while((p < do_ports_nr) && (do_ports[p] != port))
+			p++;
+		if(p == do_ports_nr)
+			do_ports[do_ports_nr++]= port;
+
+		do_port_index[i]= p;
+		do_port_lines[i]= g_APinDescription[do_pins[i]].ulPin;
+
+		digital_outputs[i].min_on_time= do_min_time_none;
+		digital_outputs[i].min_off_time= do_min_time_none;
+		digital_outputs[i].change_time= millis();
+		digital_outputs[i].pulse_time= 0;
+		digital_outputs[i].pulse_duration= 0;
+	}
+
+	//All deactivated
+	do_shadow= 0x0000;
+	do_states= 0x0000;
+}
+
+/*------------------------------------------------------------------
+ * Set the minimum time [ms] activated and deactivated of @output
+ * (genset start/stop relays)
+ * ----------------------------------------------------------------*/
+void do_set_min_times(uint8_t output, uint16_t min_on_time, uint16_t min_off_time){
+	if(output >= do_outputs_nr)
+		return;
+
+	digital_outputs[output].min_on_time= min_on_time;
+	digital_outputs[output].min_off_time= min_off_time;
+}
+
+/*------------------------------------------------------------------
+ * Activate the outputs of @mask
+ * ----------------------------------------------------------------*/
+void do_set(uint16_t mask){
+	do_write(mask, mask);
+}
+
+/*------------------------------------------------------------------
+ * Deactivate the outputs of @mask
+ * ----------------------------------------------------------------*/
+void do_clear(uint16_t mask){
+	do_write(mask, 0x0000);
+}
+
+/*------------------------------------------------------------------
+ * Write @states to the outputs of @mask
+ * A pulse running on the outputs is cancelled
+ * ----------------------------------------------------------------*/
+void do_write(uint16_t mask, uint16_t states){
+	for(uint8_t i= 0; i < do_outputs_nr; i++){
+		if(mask & (1 << i))
+			digital_outputs[i].pulse_duration= 0;
+	}
+
+	do_shadow= (do_shadow & ~mask) | (states & mask);
+}
+
+/*------------------------------------------------------------------
+ * Activate the outputs of @mask for @duration [ms]
+ * The output is deactivated by manage_digital_outputs at the end
+ * (never before its minimum time activated)
+ * ----------------------------------------------------------------*/
+void do_pulse(uint16_t mask, uint16_t duration){
+	uint32_t now= millis();
+
+	for(uint8_t i= 0; i < do_outputs_nr; i++){
+		if(!(mask & (1 << i)))
+			continue;
+
+		digital_outputs[i].pulse_time= now;
+		digital_outputs[i].pulse_duration= duration;
+	}
+
+	do_shadow|= mask;
+}
+
+/*------------------------------------------------------------------
+ * Apply the shadow to the ports - called from main loop each 1ms
+ * Pulses ended are deactivated, changes before the minimum on/off
+ * time are held, then each port gets one set and one clear write
+ * (PIO_SODR/PIO_CODR - no read-modify-write of the port)
+ * ----------------------------------------------------------------*/
+void manage_digital_outputs(){
+	uint32_t now= millis();
+
+	//Pulses ended - counted from the output activated on the port
+	for(uint8_t i= 0; i < do_outputs_nr; i++){
+		_digital_output *output= &digital_outputs[i];
+
+		if(output->pulse_duration && (do_states & (1 << i)) &&
+		   ((uint32_t)(now - output->pulse_time) >= output->pulse_duration)){
+			output->pulse_duration= 0;
+			do_shadow&= ~(1 << i);
+		}
+	}
+
+	uint16_t changes= do_shadow ^ do_states;
+	if(!changes)
+		return;
+
+	//Changes allowed by the minimum on/off times
+	uint32_t set_lines[do_outputs_nr];
+	uint32_t clear_lines[do_outputs_nr];
+	for(uint8_t p= 0; p < do_ports_nr; p++){
+		set_lines[p]= 0x00000000;
+		clear_lines[p]= 0x00000000;
+	}
+
+	for(uint8_t i= 0; i < do_outputs_nr; i++){
+		_digital_output *output= &digital_outputs[i];
+		uint16_t bit= (1 << i);
+
+		if(!(changes & bit))
+			continue;
+
+		uint16_t min_time= (do_states & bit) ? output->min_on_time : output->min_off_time;
+		if((uint32_t)(now - output->change_time) < min_time)
+			continue; //Held - applied on a next tick
+
+		if(do_shadow & bit){
+			set_lines[do_port_index[i]]|= do_port_lines[i];
+			//Pulse held by the minimum off time starts now
+			output->pulse_time= now;
+		}
+		else
+			clear_lines[do_port_index[i]]|= do_port_lines[i];
+
+		do_states^= bit;
+		output->change_time= now;
+	}
+
+	//One set and one clear write per port
+	for(uint8_t p= 0; p < do_ports_nr; p++){
+		if(set_lines[p])
+			do_ports[p]->PIO_SODR= set_lines[p];
+		if(clear_lines[p])
+			do_ports[p]->PIO_CODR= clear_lines[p];
+	}
 }
 
 
@@ -0,0 +1,320 @@
+/*
+ * dispatcher.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      PV setpoint dispatcher - share the PV system limit among the nodes
+ */
+
+#ifndef DISPATCHER_H_
+#define DISPATCHER_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include "pv_modbus.h"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Default setpoint change to be written [0.1% of node nominal_power]
+static const uint16_t dispatcher_deadband_default= 5; //0.5%
+
+//Default margin above the output of a node that can not reach its limit
+//(low irradiance) [0.1% of node nominal_power]
+static const uint16_t dispatcher_margin_default= 50; //5.0%
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+//Configuration
+uint16_t dispatcher_deadband;	//Setpoint change to be written [0.1%]
+uint16_t dispatcher_margin;		//Margin above the output of a node below its limit [0.1%]
+
+//Last setpoint computed for each node [0.1% of node nominal_power]
+uint16_t dispatcher_setpoint[pv_max_nodes];
+
+//Write traffic
+typedef struct{
+	uint32_t dispatches;	//Number of PV limits dispatched
+	uint32_t broadcasts;	//Setpoints written to all nodes in one frame
+	uint32_t node_writes;	//Setpoints written node by node
+	uint32_t skipped;		//Node setpoints inside the deadband - not written
+}_dispatcher_stats;
+
+_dispatcher_stats dispatcher_stats;
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the dispatcher
+ * ----------------------------------------------------------------*/
+void dispatcher_init();
+
+/*------------------------------------------------------------------
+ * Set the setpoint change to be written [0.1% of node nominal_power]
+ * ----------------------------------------------------------------*/
+void dispatcher_set_deadband(uint16_t deadband);
+
+/*------------------------------------------------------------------
+ * Share the PV system @limit [W] among the nodes by nominal power
+ * Nodes that can not reach their share give it to the others
+ * Only setpoints out of the deadband are written
+ * @sample_time is the genset sample time used to compute the limit
+ * ----------------------------------------------------------------*/
+void dispatch_pv_limit(int32_t limit, uint32_t sample_time);
+
+/*------------------------------------------------------------------
+ * Return true if @setpoint [0.1%] of @node_index must be written
+ * ----------------------------------------------------------------*/
+bool dispatcher_setpoint_changed(uint8_t node_index, uint16_t setpoint);
+
+/*------------------------------------------------------------------
+ * PV system limit [W] acknowledged by the nodes with nominal power
+ * Nodes with unknown limit are taken as not limited
+ * ----------------------------------------------------------------*/
+int32_t dispatcher_acknowledged_limit();
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the dispatcher
+ * ----------------------------------------------------------------*/
+void dispatcher_init(){
+	dispatcher_deadband= dispatcher_deadband_default;
+	dispatcher_margin= dispatcher_margin_default;
+
+	for(uint8_t i= 0; i < pv_max_nodes; i++){
+		dispatcher_setpoint[i]= pv_power_limit_max;
+	}
+
+	dispatcher_stats.dispatches= 0;
+	dispatcher_stats.broadcasts= 0;
+	dispatcher_stats.node_writes= 0;
+	dispatcher_stats.skipped= 0;
+}
+
+/*------------------------------------------------------------------
+ * Set the setpoint change to be written [0.1% of node nominal_power]
+ * ----------------------------------------------------------------*/
+void dispatcher_set_deadband(uint16_t deadband){
+	dispatcher_deadband= deadband;
+}
+
+/*------------------------------------------------------------------
+ * Share the PV system @limit [W] among the nodes by nominal power
+ * Nodes that can not reach their share give it to the others
+ * Only setpoints out of the deadband are written
+ * @sample_time is the genset sample time used to compute the limit
+ * ----------------------------------------------------------------*/
+void dispatch_pv_limit(int32_t limit, uint32_t sample_time){
+	int32_t nominal[pv_max_nodes];	//Node nominal power [W] (0= unknown)
+	int32_t capacity[pv_max_nodes];	//Maximum power the node can take [W]
+	uint32_t share_nodes= 0;		//Nodes sharing the limit (bit per node)
+	int64_t nominal_sum= 0;
+	uint32_t now= millis();
+
+	if(limit < 0)
+		limit= 0;
+
+	dispatcher_stats.dispatches++;
+
+	//Node nominal power and capacity
+	for(uint8_t i= 0; i < pv_max_nodes; i++){
+		volatile _pv_node_modbus_data *data= &pv_nodes[i].node_modbus_variables;
+
+		nominal[i]= 0;
+		if((pv_nodes[i].node_type == NoInverter) || !(data->sampled_variables & pv_sync_nominal_power))
+			continue;
+
+		nominal[i]= pv_nominal_power_to_w(i, data->nominal_power);
+		if(nominal[i] <= 0){
+			nominal[i]= 0;
+			continue;
+		}
+		capacity[i]= nominal[i];
+		share_nodes|= ((uint32_t)1 << i);
+		nominal_sum+= nominal[i];
+
+		//Output below the acknowledged limit by more than half the margin - the
+		//node can not reach it, so its capacity is the actual output plus the margin
+		if((data->sampled_variables & pv_sync_active_power) &&
+		   ((uint32_t)(now - data->active_power_time) <= pv_active_power_status.max_age) &&
+		   (pv_nodes[i].power_limit_acknowledged <= pv_power_limit_max)){
+			int32_t output= pv_active_power_to_w(i, data->active_power);
+			int32_t margin= (int32_t)(((int64_t)nominal[i] * dispatcher_margin) / 1000);
+			int32_t node_limit= (int32_t)(((int64_t)nominal[i] * pv_nodes[i].power_limit_acknowledged) / 1000);
+
+			if((output + (margin / 2)) < node_limit)
+				capacity[i]= output + margin;
+		}
+	}
+
+	//No nominal power read yet
+	if(nominal_sum == 0)
+		return;
+
+	//Plant level setpoint - nodes without nominal power
+	uint16_t plant_setpoint= pv_power_limit_max;
+	if(limit < nominal_sum)
+		plant_setpoint= (uint16_t)(((int64_t)limit * pv_power_limit_max) / nominal_sum);
+
+	//Water filling - share by nominal power, nodes reaching the capacity are
+	//fixed at it and the rest is shared again among the others
+	int64_t remaining= limit;
+	uint32_t open_nodes= share_nodes;
+	for(uint8_t pass= 0; (pass < pv_max_nodes) && open_nodes; pass++){
+		int64_t open_sum= 0;
+		for(uint8_t i= 0; i < pv_max_nodes; i++){
+			if(open_nodes & ((uint32_t)1 << i))
+				open_sum+= nominal[i];
+		}
+
+		bool capped= false;
+		int64_t pass_remaining= remaining;
+		for(uint8_t i= 0; i < pv_max_nodes; i++){
+			if(!(open_nodes & ((uint32_t)1 << i)))
+				continue;
+			if(((pass_remaining * nominal[i]) / open_sum) >= capacity[i]){
+				dispatcher_setpoint[i]= (uint16_t)(((int64_t)capacity[i] * pv_power_limit_max) / nominal[i]);
+				remaining-= capacity[i];
+				open_nodes&= ~((uint32_t)1 << i);
+				capped= true;
+			}
+		}
+
+		//Same setpoint for all nodes still open
+		if(!capped){
+			uint16_t setpoint= (uint16_t)((remaining * pv_power_limit_max) / open_sum);
+			for(uint8_t i= 0; i < pv_max_nodes; i++){
+				if(open_nodes & ((uint32_t)1 << i))
+					dispatcher_setpoint[i]= setpoint;
+			}
+			open_nodes= 0;
+			remaining= 0;
+		}
+	}
+
+	//All nodes at their capacity - the rest is shared by the room left up to
+	//the nominal power (limit above the PV system capacity)
+	if(remaining > 0){
+		int64_t room_sum= 0;
+		for(uint8_t i= 0; i < pv_max_nodes; i++){
+			if(share_nodes & ((uint32_t)1 << i))
+				room_sum+= (nominal[i] - capacity[i]);
+		}
+		for(uint8_t i= 0; (i < pv_max_nodes) && (room_sum > 0); i++){
+			if(!(share_nodes & ((uint32_t)1 << i)))
+				continue;
+			int64_t power= capacity[i] + ((remaining * (nominal[i] - capacity[i])) / room_sum);
+			if(power > nominal[i])
+				power= nominal[i];
+			dispatcher_setpoint[i]= (uint16_t)((power * pv_power_limit_max) / nominal[i]);
+		}
+	}
+
+	//Setpoints out of the deadband and same setpoint for all nodes
+	bool changed= false;
+	bool uniform= true;
+	int16_t first= -1;
+	for(uint8_t i= 0; i < pv_max_nodes; i++){
+		if(pv_nodes[i].node_type == NoInverter)
+			continue;
+
+		if(!(share_nodes & ((uint32_t)1 << i)))
+			dispatcher_setpoint[i]= plant_setpoint;
+		if(dispatcher_setpoint[i] > pv_power_limit_max)
+			dispatcher_setpoint[i]= pv_power_limit_max;
+
+		if(first < 0)
+			first= i;
+		else if(dispatcher_setpoint[i] != dispatcher_setpoint[first])
+			uniform= false;
+
+		if(dispatcher_setpoint_changed(i, dispatcher_setpoint[i]))
+			changed= true;
+	}
+
+	if(!changed){
+		dispatcher_stats.skipped++;
+		return;
+	}
+
+	//One frame for all nodes
+	if(uniform && pv_broadcast_enabled && (pv_broadcast_node_type() != NoInverter)){
+		pv_set_fleet_power_limit(dispatcher_setpoint[first], sample_time);
+		dispatcher_stats.broadcasts++;
+		return;
+	}
+
+	//Node by node - only the changed setpoints
+	for(uint8_t i= 0; i < pv_max_nodes; i++){
+		if(pv_nodes[i].node_type == NoInverter)
+			continue;
+
+		if(dispatcher_setpoint_changed(i, dispatcher_setpoint[i])){
+			pv_set_power_limit(i, dispatcher_setpoint[i], sample_time);
+			dispatcher_stats.node_writes++;
+		}
+	}
+}
+
+/*------------------------------------------------------------------
+ * Return true if @setpoint [0.1%] of @node_index must be written
+ * ----------------------------------------------------------------*/
+bool dispatcher_setpoint_changed(uint8_t node_index, uint16_t setpoint){
+	_pv_modbus_node *node= &pv_nodes[node_index];
+
+	//Compare with the setpoint waiting to be written or the last acknowledged
+	uint16_t reference= node->power_limit_acknowledged;
+	if(pv_setpoint_pending_nodes & ((uint32_t)1 << node_index))
+		reference= node->power_limit_setpoint;
+
+	//Node limit unknown (startup or node reconnected)
+	if(reference > pv_power_limit_max)
+		return(true);
+
+	if(setpoint == reference)
+		return(false);
+
+	//Full curtailment and no limitation are always written
+	if((setpoint == 0) || (setpoint == pv_power_limit_max))
+		return(true);
+
+	uint16_t difference= (setpoint > reference) ? (setpoint - reference) : (reference - setpoint);
+	return(difference > dispatcher_deadband);
+}
+
+/*------------------------------------------------------------------
+ * PV system limit [W] acknowledged by the nodes with nominal power
+ * Nodes with unknown limit are taken as not limited
+ * ----------------------------------------------------------------*/
+int32_t dispatcher_acknowledged_limit(){
+	int64_t limit= 0;
+
+	for(uint8_t i= 0; i < pv_max_nodes; i++){
+		volatile _pv_node_modbus_data *data= &pv_nodes[i].node_modbus_variables;
+
+		if((pv_nodes[i].node_type == NoInverter) || !(data->sampled_variables & pv_sync_nominal_power))
+			continue;
+
+		int32_t nominal= pv_nominal_power_to_w(i, data->nominal_power);
+		uint16_t acknowledged= pv_nodes[i].power_limit_acknowledged;
+		if(acknowledged > pv_power_limit_max)
+			acknowledged= pv_power_limit_max;
+
+		limit+= ((int64_t)nominal * acknowledged) / 1000;
+	}
+
+	return((int32_t)limit);
+}
+
+
+#endif /* DISPATCHER_H_ */
@@ -3,13 +3,256 @@
  *
  *  Created on: Dec 14, 2017
  *      Author: mniendicker
+ *
+ *      Operator display - serial character LCD refreshed from a frame
+ *      buffer, only the cells changed and a few bytes per tick
  */
 
 #ifndef DISPLAY_H_
 #define DISPLAY_H_
 
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include "hal/board.h"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Panel size - 20x4 characters
+static const uint8_t display_rows= 4;
+static const uint8_t display_cols= 20;
+
+/**
+ * Panel commands (Matrix Orbital serial LCD command set)
+ * Cursor: prefix, command, column (1..), row (1..)
+ */
+static const uint8_t display_cmd_prefix= 0xFE;
+static const uint8_t display_cmd_cursor= 0x47;
+static const uint8_t display_cmd_clear= 0x58;
+static const uint8_t display_cursor_cmd_len= 4;
+
+//Maximum bytes sent to the panel per tick - bounded refresh time
+static const uint8_t display_bytes_per_tick= 8;
+
+//Panel cursor position unknown (after a row end or the start)
+static const uint8_t display_cursor_unknown= 0xFF;
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+//Panel serial port
+Stream *display_port;
+
+/**
+ * Frame buffer written by the UI and the frame on the panel
+ *-->Only the cells different from the panel are transmitted
+ *-->Rows written since the last refresh are marked on display_dirty_rows
+ */
+char display_frame[display_rows][display_cols];
+char display_panel[display_rows][display_cols];
+uint8_t display_dirty_rows;		//Rows with cells to be compared (bit per row)
+
+//Panel cursor
+uint8_t display_cursor_row;
+uint8_t display_cursor_col;
+
+//Bytes sent to the panel
+uint32_t display_bytes_sent;
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the display - panel cleared on @port
+ * ----------------------------------------------------------------*/
+void init_display(Stream *port);
+
+/*------------------------------------------------------------------
+ * Clear the frame buffer
+ * ----------------------------------------------------------------*/
+void display_clear();
+
+/*------------------------------------------------------------------
+ * Write @text on the frame buffer at @row, @col (clipped at the row end)
+ * ----------------------------------------------------------------*/
+void display_print(uint8_t row, uint8_t col, const char *text);
+
+/*------------------------------------------------------------------
+ * Write @value right aligned on @width characters at @row, @col
+ * @decimals digits after the decimal point
+ * ----------------------------------------------------------------*/
+void display_print_number(uint8_t row, uint8_t col, int32_t value, uint8_t width, uint8_t decimals);
+
+/*------------------------------------------------------------------
+ * Frame buffer fully transmitted to the panel
+ * ----------------------------------------------------------------*/
+bool display_updated();
+
+/*------------------------------------------------------------------
+ * Send the changed cells to the panel - called from main loop each 1ms
+ * ----------------------------------------------------------------*/
+void manage_display();
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the display - panel cleared on @port
+ * ----------------------------------------------------------------*/
+void init_display(Stream *port){
+	display_port= port;
+
+	//Panel cleared - frame and panel blank
+	memset(display_frame, ' ', sizeof(display_frame));
+	memset(display_panel, ' ', sizeof(display_panel));
+	display_dirty_rows= 0x00;
+
+	display_cursor_row= display_cursor_unknown;
+	display_cursor_col= display_cursor_unknown;
+	display_bytes_sent= 0;
+
+	display_port->write(display_cmd_prefix);
+	display_port->write(display_cmd_clear);
+}
+
+/*------------------------------------------------------------------
+ * Clear the frame buffer
+ * ----------------------------------------------------------------*/
+void display_clear(){
+	memset(display_frame, ' ', sizeof(display_frame));
+	display_dirty_rows= (1 << display_rows) - 1;
+}
+
+/*------------------------------------------------------------------
+ * Write @text on the frame buffer at @row, @col (clipped at the row end)
+ * ----------------------------------------------------------------*/
+void display_print(uint8_t row, uint8_t col, const char *text){
+	if(row >= display_rows)
+		return;
+
+	while((col < display_cols) && *text)
+		display_frame[row][col++]= *text++;
+
+	display_dirty_rows|= (1 << row);
+}
+
+/*------------------------------------------------------------------
+ * Write @value right aligned on @width characters at @row, @col
+ * @decimals digits after the decimal point
+ * Values that do not fit are shown as '*'
+ * ----------------------------------------------------------------*/
+void display_print_number(uint8_t row, uint8_t col, int32_t value, uint8_t width, uint8_t decimals){
+	char text[display_cols + 1];
+	uint32_t magnitude= (value < 0) ? -(uint32_t)value : (uint32_t)value;
+	int8_t pos;
+
+	if(width > display_cols)
+		width= display_cols;
+	text[width]= '\0';
+
+	//Digits from the right - at least one before the decimal point
+	pos= width - 1;
+	for(uint8_t digits= 0; (pos >= 0) && ((magnitude != 0) || (digits <= decimals)); digits++){
+		if((digits == decimals) && (decimals != 0)){
+			text[pos--]= '.';
+			if(pos < 0)
+				break;
+		}
+		text[pos--]= '0' + (magnitude % 10);
+		magnitude/= 10;
+	}
+	bool sign_fits= true;
+	if(value < 0){
+		if(pos >= 0)
+			text[pos--]= '-';
+		else
+			sign_fits= false;
+	}
+
+	//Does not fit
+	if((magnitude != 0) || !sign_fits){
+		memset(text, '*', width);
+		pos= -1;
+	}
+
+	while(pos >= 0)
+		text[pos--]= ' ';
+
+	display_print(row, col, text);
+}
+
+/*------------------------------------------------------------------
+ * Frame buffer fully transmitted to the panel
+ * ----------------------------------------------------------------*/
+bool display_updated(){
+	return(display_dirty_rows == 0x00);
+}
+
+/*------------------------------------------------------------------
+ * Send the changed cells to the panel - called from main loop each 1ms
+ * At most display_bytes_per_tick bytes and never more than the serial
+ * buffer room: the loop is never blocked by the panel. The cursor is
+ * moved only when the next changed cell is far from it (short gaps are
+ * cheaper to send again than a cursor command)
+ * ----------------------------------------------------------------*/
+void manage_display(){
+	if(!display_dirty_rows)
+		return;
+
+	int budget= display_port->availableForWrite();
+	if(budget > display_bytes_per_tick)
+		budget= display_bytes_per_tick;
+
+	for(uint8_t row= 0; (row < display_rows) && (budget > 0); row++){
+		if(!(display_dirty_rows & (1 << row)))
+			continue;
+
+		uint8_t col= 0;
+		while(budget > 0){
+			//Next changed cell of the row
+			while((col < display_cols) && (display_frame[row][col] == display_panel[row][col]))
+				col++;
+			if(col >= display_cols){
+				display_dirty_rows&= ~(1 << row);
+				break;
+			}
+
+			//Cursor on the row before the cell and close to it - cells between sent again
+			if((display_cursor_row == row) && (display_cursor_col <= col) &&
+			   ((col - display_cursor_col) < display_cursor_cmd_len)){
+				col= display_cursor_col;
+			}
+			else{
+				if(budget < (display_cursor_cmd_len + 1))
+					return;
+				display_port->write(display_cmd_prefix);
+				display_port->write(display_cmd_cursor);
+				display_port->write((uint8_t)(col + 1));
+				display_port->write((uint8_t)(row + 1));
+				budget-= display_cursor_cmd_len;
+				display_bytes_sent+= display_cursor_cmd_len;
+				display_cursor_row= row;
+				display_cursor_col= col;
+			}
 
+			display_port->write((uint8_t)display_frame[row][col]);
+			display_panel[row][col]= display_frame[row][col];
+			budget--;
+			display_bytes_sent++;
 
+			//Panel cursor advances - position not known after the row end
+			if(++col < display_cols)
+				display_cursor_col= col;
+			else
+				display_cursor_row= display_cursor_col= display_cursor_unknown;
+		}
+	}
+}
 
 
 #endif /* DISPLAY_H_ */
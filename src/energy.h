@@ -0,0 +1,156 @@
+/*
+ * energy.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Energy integration (Wh) for PV inverters and gensets
+ */
+
+#ifndef ENERGY_H_
+#define ENERGY_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include <stdint.h>
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+/**
+ * Energy accumulators are 64 bits fixed point.
+ * 1 LSB = 1 W.ms, so 1 Wh = 3600000 LSB
+ */
+static const int64_t energy_lsb_per_wh= 3600000;
+
+/**
+ * Maximum time between two samples of the same node to integrate.
+ * Longer intervals are considered a gap (node not read) and the
+ * integration restarts from the new sample.
+ */
+static const uint32_t energy_max_gap_ms= 10000; //10s
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+//Trapezoidal integrator for each node
+typedef struct{
+	int32_t last_power;			//Last sample power [W]
+	uint32_t last_sample_time;	//Last sample timestamp [ms]
+	bool last_sample_valid;		//Last sample can be used for integration
+	int64_t energy;				//Node energy [W.ms]
+}_energy_integrator;
+
+//Energy delivered to the load (PV + gensets) [W.ms]
+int64_t load_energy_total;
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Reset the integrator and its energy accumulator
+ * ----------------------------------------------------------------*/
+void energy_init(_energy_integrator *integrator);
+
+/*------------------------------------------------------------------
+ * Integrate a new sample of @power [W] taken at @sample_time [ms]
+ * Return the energy added since the previous sample [W.ms]
+ * ----------------------------------------------------------------*/
+int64_t energy_integrate(_energy_integrator *integrator, int32_t power, uint32_t sample_time);
+
+/*------------------------------------------------------------------
+ * Signal a gap in the samples (node disconnected)
+ * The next sample restarts the integration
+ * ----------------------------------------------------------------*/
+void energy_gap(_energy_integrator *integrator);
+
+/*------------------------------------------------------------------
+ * Convert the @energy accumulator [W.ms] to Wh
+ * ----------------------------------------------------------------*/
+int64_t energy_to_wh(int64_t energy);
+
+/*------------------------------------------------------------------
+ * PV share of the load energy [0.1%]
+ * ----------------------------------------------------------------*/
+uint16_t energy_pv_share(int64_t pv_energy);
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Reset the integrator and its energy accumulator
+ * ----------------------------------------------------------------*/
+void energy_init(_energy_integrator *integrator){
+	integrator->last_power= 0;
+	integrator->last_sample_time= 0;
+	integrator->last_sample_valid= false;
+	integrator->energy= 0;
+}
+
+/*------------------------------------------------------------------
+ * Integrate a new sample of @power [W] taken at @sample_time [ms]
+ * Return the energy added since the previous sample [W.ms]
+ * Cheap enough to be called from the modbus decode callback
+ * ----------------------------------------------------------------*/
+int64_t energy_integrate(_energy_integrator *integrator, int32_t power, uint32_t sample_time){
+	int64_t increment= 0;
+
+	if(integrator->last_sample_valid){
+		uint32_t delta_time= sample_time - integrator->last_sample_time;
+
+		//Trapezoidal rule - (P0 + P1) * dt / 2
+		if(delta_time <= energy_max_gap_ms){
+			increment= ((int64_t)integrator->last_power + power) * delta_time;
+			increment/= 2;
+			integrator->energy+= increment;
+		}
+	}
+
+	integrator->last_power= power;
+	integrator->last_sample_time= sample_time;
+	integrator->last_sample_valid= true;
+
+	return(increment);
+}
+
+/*------------------------------------------------------------------
+ * Signal a gap in the samples (node disconnected)
+ * The next sample restarts the integration
+ * ----------------------------------------------------------------*/
+void energy_gap(_energy_integrator *integrator){
+	integrator->last_sample_valid= false;
+}
+
+/*------------------------------------------------------------------
+ * Convert the @energy accumulator [W.ms] to Wh
+ * ----------------------------------------------------------------*/
+int64_t energy_to_wh(int64_t energy){
+	return(energy / energy_lsb_per_wh);
+}
+
+/*------------------------------------------------------------------
+ * PV share of the load energy [0.1%]
+ * ----------------------------------------------------------------*/
+uint16_t energy_pv_share(int64_t pv_energy){
+	if((load_energy_total <= 0) || (pv_energy <= 0))
+		return(0);
+	if(pv_energy >= load_energy_total)
+		return(1000);
+
+	//Scale down to keep the product inside 64 bits
+	int64_t load= load_energy_total;
+	while(load > (INT64_MAX / 1000)){
+		load>>= 1;
+		pv_energy>>= 1;
+	}
+
+	return((uint16_t)((pv_energy * 1000) / load));
+}
+
+
+#endif /* ENERGY_H_ */
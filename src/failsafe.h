@@ -0,0 +1,248 @@
+/*
+ * failsafe.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Failsafe supervisor - safe PV limit on stale genset data and
+ *      hardware watchdog fed only while the critical tasks are alive
+ */
+
+#ifndef FAILSAFE_H_
+#define FAILSAFE_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include "pv_modbus.h"
+#include "genset_modbus.h"
+#include "pi_controller.h"
+#include "ramp_limiter.h"
+#include "curtailment.h"
+#include "operating_mode.h"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Critical tasks supervised (heartbeat per task)
+static const uint8_t failsafe_task_tick= 0;			//Resource management 1ms
+static const uint8_t failsafe_task_control= 1;		//Control task
+static const uint8_t failsafe_task_genset_bus= 2;	//Genset bus transactions
+static const uint8_t failsafe_task_pv_bus= 3;		//PV bus transactions
+static const uint8_t failsafe_tasks_nr= 4;
+
+//Default deadline of each task heartbeat [ms]
+static const uint32_t failsafe_tick_deadline_default= 50;
+static const uint32_t failsafe_control_deadline_default= 3 * curtailment_period;
+static const uint32_t failsafe_bus_deadline_default= 3000; //Modbus timeout (2s) plus margin
+
+//Hardware watchdog - reset if not fed [ms]
+static const uint32_t failsafe_watchdog_timeout= 1000;
+
+//Default safe PV limit on stale genset data [0.1% of nominal_power]
+static const uint16_t failsafe_power_limit_default= 0; //0.0%
+
+//Default maximum age of genset active power before the safe limit [ms]
+static const uint32_t failsafe_genset_max_age_default= 3000;
+
+//Default maximum age of the last acknowledged write with setpoints pending [ms]
+static const uint32_t failsafe_write_max_age_default= 5000;
+
+//Failsafe status (bit mask)
+static const uint8_t failsafe_none= 0x00;
+static const uint8_t failsafe_genset_stale= 0x01;	//Genset data stale - PV at the safe limit
+static const uint8_t failsafe_pv_write_stale= 0x02;	//Setpoints not acknowledged for too long
+static const uint8_t failsafe_task_missed= 0x04;	//Some task missed its deadline - watchdog not fed
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+//Configuration
+uint16_t failsafe_power_limit;		//Safe PV limit [0.1% of nominal_power]
+uint32_t failsafe_genset_max_age;	//Genset active power age to apply the safe limit [ms]
+uint32_t failsafe_write_max_age;	//Last acknowledged write age with setpoints pending [ms]
+uint32_t failsafe_deadline[failsafe_tasks_nr];	//Heartbeat deadline of each task [ms]
+
+//Supervisor state
+uint8_t failsafe_status;						//failsafe_* bit mask
+uint32_t failsafe_heartbeat_time[failsafe_tasks_nr];	//Last heartbeat of each task [ms]
+uint32_t failsafe_write_time;	//Setpoints pending since (or last acknowledge) [ms]
+
+//Events for commissioning
+typedef struct{
+	uint16_t safe_limit;		//Safe limit applied (genset data stale)
+	uint16_t write_stale;		//Setpoints not acknowledged for too long
+	uint16_t deadline_missed;	//Task deadlines missed (watchdog not fed)
+	uint8_t missed_tasks;		//Tasks late on the last miss (bit per task)
+}_failsafe_events;
+
+_failsafe_events failsafe_events;
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the failsafe supervisor
+ * ----------------------------------------------------------------*/
+void failsafe_init();
+
+/*------------------------------------------------------------------
+ * Signal that @task is alive
+ * ----------------------------------------------------------------*/
+void failsafe_heartbeat(uint8_t task);
+
+/*------------------------------------------------------------------
+ * Return true while the safe PV limit is applied
+ * ----------------------------------------------------------------*/
+bool failsafe_active();
+
+/*------------------------------------------------------------------
+ * Return true if the genset data used by the control is stale
+ * ----------------------------------------------------------------*/
+bool failsafe_genset_data_stale();
+
+/*------------------------------------------------------------------
+ * Supervise the tasks and data ages - called from main loop each 1ms
+ * The hardware watchdog is fed only if all tasks met their deadlines
+ * ----------------------------------------------------------------*/
+void manage_failsafe();
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Hardware watchdog setup - called by the core before setup()
+ * The SAM3X watchdog mode register can be written only once
+ * ----------------------------------------------------------------*/
+void watchdogSetup(){
+	watchdogEnable(failsafe_watchdog_timeout);
+}
+
+/*------------------------------------------------------------------
+ * Initialize the failsafe supervisor
+ * Genset data is stale at startup - the safe limit is applied until
+ * the first genset values (safe state after a watchdog reset)
+ * ----------------------------------------------------------------*/
+void failsafe_init(){
+	failsafe_power_limit= failsafe_power_limit_default;
+	failsafe_genset_max_age= failsafe_genset_max_age_default;
+	failsafe_write_max_age= failsafe_write_max_age_default;
+
+	failsafe_deadline[failsafe_task_tick]= failsafe_tick_deadline_default;
+	failsafe_deadline[failsafe_task_control]= failsafe_control_deadline_default;
+	failsafe_deadline[failsafe_task_genset_bus]= failsafe_bus_deadline_default;
+	failsafe_deadline[failsafe_task_pv_bus]= failsafe_bus_deadline_default;
+
+	failsafe_status= failsafe_none;
+	for(uint8_t i= 0; i < failsafe_tasks_nr; i++)
+		failsafe_heartbeat_time[i]= millis();
+	failsafe_write_time= millis();
+
+	failsafe_events.safe_limit= 0;
+	failsafe_events.write_stale= 0;
+	failsafe_events.deadline_missed= 0;
+	failsafe_events.missed_tasks= 0;
+}
+
+/*------------------------------------------------------------------
+ * Signal that @task is alive
+ * ----------------------------------------------------------------*/
+void failsafe_heartbeat(uint8_t task){
+	if(task < failsafe_tasks_nr)
+		failsafe_heartbeat_time[task]= millis();
+}
+
+/*------------------------------------------------------------------
+ * Return true while the safe PV limit is applied
+ * ----------------------------------------------------------------*/
+bool failsafe_active(){
+	return(failsafe_status & failsafe_genset_stale);
+}
+
+/*------------------------------------------------------------------
+ * Return true if the genset data used by the control is stale
+ * Only the island depends on genset data
+ * ----------------------------------------------------------------*/
+bool failsafe_genset_data_stale(){
+	if(operating_mode == mode_grid_tied)
+		return(false);
+
+	if(genset_active_power_status.contributors == 0)
+		return(true);
+
+	return((uint32_t)(millis() - genset_active_power_status.newest_time) > failsafe_genset_max_age);
+}
+
+/*------------------------------------------------------------------
+ * Supervise the tasks and data ages - called from main loop each 1ms
+ * The hardware watchdog is fed only if all tasks met their deadlines
+ * ----------------------------------------------------------------*/
+void manage_failsafe(){
+	uint32_t now= millis();
+
+	//Genset data stale - safe PV limit (broadcast if possible)
+	if(failsafe_genset_data_stale()){
+		if(!(failsafe_status & failsafe_genset_stale)){
+			failsafe_status|= failsafe_genset_stale;
+			failsafe_events.safe_limit++;
+
+			//Control restarts from the safe limit when the data is back
+			curtailment_pv_limit= (int32_t)(((int64_t)pv_nominal_power_total * failsafe_power_limit) / 1000);
+			curtailment_pv_limit_percent= failsafe_power_limit;
+			pi_reset(&curtailment_pi, curtailment_pv_limit);
+			ramp_reset(&curtailment_ramp, curtailment_pv_limit);
+
+			pv_set_fleet_power_limit(failsafe_power_limit, now);
+		}
+	}
+	else{
+		failsafe_status&= ~failsafe_genset_stale;
+	}
+
+	//Setpoints written but not acknowledged for too long (PV bus lost)
+	//or not confirmed by read back after all retries
+	//Age since the setpoints became pending or the last acknowledge - a node
+	//failed is not cleared by the acknowledges of the others
+	bool failed= pv_setpoint_failed();
+	bool pending= pv_setpoint_pending() || failed;
+	if(!pending)
+		failsafe_write_time= now;
+	else if(!failed && ((int32_t)(pv_setpoint_ack_time - failsafe_write_time) > 0))
+		failsafe_write_time= pv_setpoint_ack_time;
+
+	if(pending && ((uint32_t)(now - failsafe_write_time) > failsafe_write_max_age)){
+		if(!(failsafe_status & failsafe_pv_write_stale)){
+			failsafe_status|= failsafe_pv_write_stale;
+			failsafe_events.write_stale++;
+		}
+	}
+	else{
+		failsafe_status&= ~failsafe_pv_write_stale;
+	}
+
+	//Critical tasks - a missed deadline stops the watchdog feed (reset)
+	uint8_t missed= 0;
+	for(uint8_t i= 0; i < failsafe_tasks_nr; i++){
+		if((uint32_t)(now - failsafe_heartbeat_time[i]) > failsafe_deadline[i])
+			missed|= (1 << i);
+	}
+
+	if(missed){
+		if(!(failsafe_status & failsafe_task_missed)){
+			failsafe_status|= failsafe_task_missed;
+			failsafe_events.deadline_missed++;
+			failsafe_events.missed_tasks= missed;
+		}
+		return;
+	}
+
+	failsafe_status&= ~failsafe_task_missed;
+	watchdogReset();
+}
+
+
+#endif /* FAILSAFE_H_ */
@@ -24,11 +24,15 @@ public:
 	static const uint16_t nominal_power= 13018; 		//Register address - Nominal power of genset
 	static const uint8_t nominal_power_nr= 1; 			//Number of registers
 	static const float nominal_power_scale;				//Scale for conversion (value= received * scale)
+	static const int32_t nominal_power_w_mul= 1000;		//Integer conversion to W (value= received * mul / div)
+	static const int32_t nominal_power_w_div= 1;		//(1 kW= 1000 W)
 	typedef uint16_t GENSET_NOMINAL_POWER_DATA;			//Data type
 
 	static const uint16_t active_power= 61;				//Register address - Actual active power generated
 	static const uint8_t active_power_nr= 2;			//Number of registers
 	static const float active_power_scale;				//Scale for conversion (value= received * scale)
+	static const int32_t active_power_w_mul= 125;		//Integer conversion to W (value= received * mul / div)
+	static const int32_t active_power_w_div= 32;		//(1/256 kW= 125/32 W)
 	typedef int32_t GENSET_TOTAL_ACTIVE_POWER_DATA;		//Data type
 
 	static const uint16_t gcb_status= 138;				//Register address - GCB status of genset
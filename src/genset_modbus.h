@@ -15,6 +15,8 @@
 #include "lib/modbus_master.h"
 #include "hal/board.h"
 #include "rs485.h"
+#include "energy.h"
+#include "sequence_of_events.h"
 
 /*------------------------------------------------------------------
  *					GLOBAL CONSTANTS
@@ -24,11 +26,24 @@ static const uint16_t genset_sync_none  		= 0x0000; //No comunication ongoing
 static const uint16_t genset_sync_active_power  = 0x0001; //New active power read from any node
 static const uint16_t genset_sync_nominal_power = 0x0002; //New nominal power read from any node
 static const uint16_t genset_sync_comm_status   = 0x0004; //New communication status from any node
+static const uint16_t genset_sync_reverse_power = 0x0008; //Reverse power detected on any node
+static const uint16_t genset_sync_breakers		= 0x0010; //Circuit breakers status changed on any node
 
 //Node communication status control
 static const uint8_t genset_min_comm_errors= 0x00; //Pass from timeout to connected
 static const uint8_t genset_max_comm_errors= 0x03; //Pass from timeout to disconnected
 
+//Default maximum age of each variable to be used on totals
+static const uint32_t genset_active_power_max_age_default= 10000; 	//10s
+static const uint32_t genset_nominal_power_max_age_default= 60000; 	//60s
+
+//Default reverse power threshold [0.1% of node nominal power]
+static const uint16_t genset_reverse_power_threshold_default= 20; //2.0%
+
+//Default time below the running threshold (twice the reverse power one) to
+//disarm the reverse power detection of a node - genset stopped or unloaded
+static const uint32_t genset_reverse_power_disarm_time_default= 10000; //10s
+
 
 /*------------------------------------------------------------------
  * 					GLOBAL VARIABLES
@@ -40,6 +55,14 @@ ModbusMaster genset_node;
 typedef struct{
 	volatile uint32_t active_power;  //Actual deliverable power (ADP)
 	volatile uint32_t nominal_power; //Deliverable power (DP)
+	volatile uint16_t breakers_status; //Circuit breakers status (controller bit masks)
+
+	//Acquisition time of each variable [ms]
+	volatile uint32_t active_power_time;
+	volatile uint32_t nominal_power_time;
+	volatile uint32_t breakers_time;
+	//Variables already read from node (genset_sync_* mask)
+	volatile uint16_t sampled_variables;
 }_genset_node_modbus_data;
 
 //Each node information
@@ -55,14 +78,40 @@ typedef struct{
 
 	_genset_node_modbus_data node_modbus_variables;
 
+	//Active power integration
+	_energy_integrator node_energy;
+
+	//Reverse power detection armed - genset was loaded above twice the threshold
+	bool reverse_power_armed;
+	uint32_t reverse_power_running_time;	//Last sample above twice the threshold [ms]
+
 }_genset_modbus_node;
 
 //All nodes access
 _genset_modbus_node genset_nodes[genset_max_nodes];
 
 //Gensets total calculation
-uint32_t genset_active_power_total; //Actual deliverable power (ADPt) - Sum of all gensets
-uint32_t genset_nominal_power_total; //Deliverable power total (DPt) - Sum of all gensets
+int32_t genset_active_power_total;  //Actual deliverable power (ADPt) [W] - Sum of all gensets
+int32_t genset_nominal_power_total; //Deliverable power total (DPt) [W] - Sum of all gensets
+int64_t genset_energy_total;		  //Active energy [W.ms] - Sum of all gensets
+
+//Staleness of each total calculation
+typedef struct{
+	uint32_t max_age;		//Maximum age of a value to be used on total [ms]
+	uint32_t oldest_time;	//Acquisition time of the oldest value used on total [ms]
+	uint32_t newest_time;	//Acquisition time of the newest value used on total [ms]
+	uint32_t stale_nodes;	//Nodes excluded from total - stale values (bit per node)
+	uint8_t contributors;	//Number of values used on total
+}_genset_total_status;
+
+_genset_total_status genset_active_power_status;	//Active power total (ADPt) staleness
+_genset_total_status genset_nominal_power_status;	//Nominal power total (DPt) staleness
+
+//Reverse power detection
+uint16_t genset_reverse_power_threshold;	//Active power threshold [0.1% of node nominal power]
+uint32_t genset_reverse_power_disarm_time;	//Time below the running threshold to disarm a node [ms]
+uint32_t genset_reverse_power_nodes;		//Nodes at or below the threshold (bit per node)
+uint32_t genset_reverse_power_time;			//Last detection time [us]
 
 //Modbus new data available synchronization flag
 uint16_t genset_flag_sync;
@@ -122,12 +171,44 @@ uint8_t genset_read_active_power(uint8_t addr);
  * ----------------------------------------------------------------*/
 uint8_t genset_read_nominal_power(uint8_t node_index);
 
+/*-----------------------------------------------------------------
+ * Read circuit breakers status from specified node
+ * ----------------------------------------------------------------*/
+uint8_t genset_read_breakers(uint8_t node_index);
+
 /*------------------------------------------------------------------
  *Update node communication status
  *@sucess define if the last modbus transaction was successful
  *----------------------------------------------------------------*/
 void genset_update_communication_status(uint8_t node_index, bool sucess);
 
+/*------------------------------------------------------------------
+ *Convert the @active_power received from @node_index to W
+ *----------------------------------------------------------------*/
+int32_t genset_active_power_to_w(uint8_t node_index, uint32_t active_power);
+
+/*------------------------------------------------------------------
+ *Convert the @nominal_power received from @node_index to W
+ *----------------------------------------------------------------*/
+int32_t genset_nominal_power_to_w(uint8_t node_index, uint32_t nominal_power);
+
+/*------------------------------------------------------------------
+ *Check the @active_power [W] of @node_index against the reverse power
+ *threshold - called on each active power sample
+ *----------------------------------------------------------------*/
+void genset_check_reverse_power(uint8_t node_index, int32_t active_power);
+
+/*------------------------------------------------------------------
+ *Stop the reverse power detection of @node_index until it is loaded
+ *again - the node is no longer signaled
+ *----------------------------------------------------------------*/
+void genset_reverse_power_disarm(uint8_t node_index);
+
+/*------------------------------------------------------------------
+ *Return true if @node_index reported its GCB opened (genset off the bus)
+ *----------------------------------------------------------------*/
+bool genset_gcb_opened(uint8_t node_index);
+
 /*------------------------------------------------------------------
  *Read modbus variables from gensets controllers
  *Return true if transaction is finished (with success or not)
@@ -139,6 +220,29 @@ bool genset_read_modbus_variables(uint8_t genset_node_read);
  *----------------------------------------------------------------*/
 void manage_genset_system();
 
+/*------------------------------------------------------------------
+ *Set the maximum age [ms] of @variable (genset_sync_*) to be used on totals
+ *----------------------------------------------------------------*/
+void genset_set_max_age(uint16_t variable, uint32_t max_age);
+
+/*------------------------------------------------------------------
+ *Sum @variable (genset_sync_*) of all nodes in W, excluding stale values
+ *@status receives the stale nodes and the oldest value used
+ *----------------------------------------------------------------*/
+int32_t genset_aggregate(uint16_t variable, _genset_total_status *status);
+
+/*------------------------------------------------------------------
+ *Check if the oldest value used on totals exceeded its maximum age
+ *Called from main loop - set the flag to recalculate the totals
+ *----------------------------------------------------------------*/
+void genset_check_stale_values();
+
+/*------------------------------------------------------------------
+ *Age [ms] of the oldest value used on total of @status
+ *Return 0xFFFFFFFF if no value was used
+ *----------------------------------------------------------------*/
+uint32_t genset_oldest_age(const _genset_total_status *status);
+
 
 /*------------------------------------------------------------------
 * 					FUNCTIONS DEFINITION
@@ -170,6 +274,14 @@ void genset_init_modbus(uint8_t addr){
 		genset_nodes[i].node_comm_error_counter= 0;
 		genset_nodes[i].node_modbus_variables.active_power= 0x0000;
 		genset_nodes[i].node_modbus_variables.nominal_power= 0x0000;
+		genset_nodes[i].node_modbus_variables.breakers_status= 0x0000;
+		genset_nodes[i].node_modbus_variables.active_power_time= 0;
+		genset_nodes[i].node_modbus_variables.nominal_power_time= 0;
+		genset_nodes[i].node_modbus_variables.breakers_time= 0;
+		genset_nodes[i].node_modbus_variables.sampled_variables= genset_sync_none;
+		energy_init(&genset_nodes[i].node_energy);
+		genset_nodes[i].reverse_power_armed= false;
+		genset_nodes[i].reverse_power_running_time= 0;
 	}
 
 	//Synchronization variables
@@ -179,6 +291,25 @@ void genset_init_modbus(uint8_t addr){
 	//Gensets total calculation
 	genset_active_power_total= 0; //Actual deliverable power (ADPt) - Sum of all gensets
 	genset_nominal_power_total= 0; //Deliverable power total (DPt) - Sum of all gensets
+	genset_energy_total= 0;
+
+	//Totals staleness
+	genset_active_power_status.max_age= genset_active_power_max_age_default;
+	genset_active_power_status.oldest_time= 0;
+	genset_active_power_status.newest_time= 0;
+	genset_active_power_status.stale_nodes= 0;
+	genset_active_power_status.contributors= 0;
+	genset_nominal_power_status.max_age= genset_nominal_power_max_age_default;
+	genset_nominal_power_status.oldest_time= 0;
+	genset_nominal_power_status.newest_time= 0;
+	genset_nominal_power_status.stale_nodes= 0;
+	genset_nominal_power_status.contributors= 0;
+
+	//Reverse power detection
+	genset_reverse_power_threshold= genset_reverse_power_threshold_default;
+	genset_reverse_power_disarm_time= genset_reverse_power_disarm_time_default;
+	genset_reverse_power_nodes= 0;
+	genset_reverse_power_time= 0;
 
 	//Modbus new data available synchronization flag
 	genset_flag_sync&= genset_sync_none;
@@ -228,12 +359,20 @@ void genset_set_timeout(uint16_t new_timeout){
 bool genset_read_modbus_variables(uint8_t genset_node_read){
 	const uint8_t scheduler_active_power= 	0x02; //Read active power from node [PV or Genset]
 	const uint8_t scheduler_nominal_power= 	0x04; //Read nominal power from node [PV or Genset]
+	const uint8_t scheduler_breakers= 		0x08; //Read circuit breakers status from node [Genset]
 
 	static uint8_t function_scheduler= 	scheduler_active_power; //Scheduler for each node variable read
 
 	if(function_scheduler == scheduler_active_power){
 		uint8_t result= genset_read_active_power(genset_node_read);
 		//Previous read_active_power transaction has finished
+		if((result == transaction_idle) || (result == transaction_timeout)){
+			//Read next variable
+			function_scheduler= scheduler_breakers;
+		}
+	}
+	else if(function_scheduler == scheduler_breakers){
+		uint8_t result= genset_read_breakers(genset_node_read);
 		if((result == transaction_idle) || (result == transaction_timeout)){
 			//Read next variable
 			function_scheduler= scheduler_nominal_power;
@@ -258,18 +397,12 @@ bool genset_read_modbus_variables(uint8_t genset_node_read){
 void manage_genset_system(){
 	//New nominal power - recalculate total nominal power (DPt)
 	if(genset_flag_sync & genset_sync_nominal_power){
-		genset_nominal_power_total= 0x00000000;
-		for(uint8_t i= 0; i < genset_max_nodes; i++){
-			genset_nominal_power_total+= genset_nodes[i].node_modbus_variables.nominal_power;
-		}
+		genset_nominal_power_total= genset_aggregate(genset_sync_nominal_power, &genset_nominal_power_status);
 		genset_flag_sync&= ~genset_sync_nominal_power; //Reset flag
 	}
 	//New active power - recalculate total active power (ADPt)
 	if(genset_flag_sync & genset_sync_active_power){
-		genset_active_power_total= 0x00000000;
-		for(uint8_t i= 0; i < genset_max_nodes; i++){
-			genset_active_power_total+= genset_nodes[i].node_modbus_variables.active_power;
-		}
+		genset_active_power_total= genset_aggregate(genset_sync_active_power, &genset_active_power_status);
 		genset_flag_sync&= ~genset_sync_active_power; //Reset flag
 	}
 	//New communication status - some node has the communication status changed
@@ -279,6 +412,83 @@ void manage_genset_system(){
 	}
 }
 
+/*------------------------------------------------------------------
+ *Set the maximum age [ms] of @variable (genset_sync_*) to be used on totals
+ *----------------------------------------------------------------*/
+void genset_set_max_age(uint16_t variable, uint32_t max_age){
+	if(variable == genset_sync_active_power)
+		genset_active_power_status.max_age= max_age;
+	else if(variable == genset_sync_nominal_power)
+		genset_nominal_power_status.max_age= max_age;
+}
+
+/*------------------------------------------------------------------
+ *Sum @variable (genset_sync_*) of all nodes in W, excluding stale values
+ *@status receives the stale nodes and the oldest value used
+ *----------------------------------------------------------------*/
+int32_t genset_aggregate(uint16_t variable, _genset_total_status *status){
+	int32_t total= 0x00000000;
+	uint32_t now= millis();
+
+	status->oldest_time= now;
+	status->newest_time= 0;
+	status->stale_nodes= 0;
+	status->contributors= 0;
+
+	for(uint8_t i= 0; i < genset_max_nodes; i++){
+		volatile _genset_node_modbus_data *data= &genset_nodes[i].node_modbus_variables;
+
+		//Variable never read from this node
+		if(!(data->sampled_variables & variable))
+			continue;
+
+		int32_t value= (variable == genset_sync_active_power) ?
+				genset_active_power_to_w(i, data->active_power) : genset_nominal_power_to_w(i, data->nominal_power);
+		uint32_t sample_time= (variable == genset_sync_active_power) ? data->active_power_time : data->nominal_power_time;
+
+		//Stale value - excluded from total
+		if((uint32_t)(now - sample_time) > status->max_age){
+			status->stale_nodes|= ((uint32_t)1 << i);
+			continue;
+		}
+
+		total+= value;
+		status->contributors++;
+		if((int32_t)(sample_time - status->oldest_time) < 0)
+			status->oldest_time= sample_time;
+		if((status->contributors == 1) || ((int32_t)(sample_time - status->newest_time) > 0))
+			status->newest_time= sample_time;
+	}
+
+	return(total);
+}
+
+/*------------------------------------------------------------------
+ *Check if the oldest value used on totals exceeded its maximum age
+ *Called from main loop - set the flag to recalculate the totals
+ *----------------------------------------------------------------*/
+void genset_check_stale_values(){
+	if(genset_active_power_status.contributors &&
+	  (genset_oldest_age(&genset_active_power_status) > genset_active_power_status.max_age)){
+		genset_flag_sync|= genset_sync_active_power;
+	}
+	if(genset_nominal_power_status.contributors &&
+	  (genset_oldest_age(&genset_nominal_power_status) > genset_nominal_power_status.max_age)){
+		genset_flag_sync|= genset_sync_nominal_power;
+	}
+}
+
+/*------------------------------------------------------------------
+ *Age [ms] of the oldest value used on total of @status
+ *Return 0xFFFFFFFF if no value was used
+ *----------------------------------------------------------------*/
+uint32_t genset_oldest_age(const _genset_total_status *status){
+	if(status->contributors == 0)
+		return(0xFFFFFFFF);
+
+	return((uint32_t)(millis() - status->oldest_time));
+}
+
 /*------------------------------------------------------------------
  *Callback function for all successful modbus transactions
  *----------------------------------------------------------------*/
@@ -290,11 +500,23 @@ void genset_successful_transaction(){
 
 		//Recovery the entire value
 		active_power|= register_high;
-		active_power<<= 8;
+		active_power<<= 16;
 		active_power|= register_low;
 
 		//Update Modbus variable
 		genset_nodes[genset_global_node_index].node_modbus_variables.active_power= active_power;
+		genset_nodes[genset_global_node_index].node_modbus_variables.active_power_time= genset_node.getResponseTime();
+		genset_nodes[genset_global_node_index].node_modbus_variables.sampled_variables|= genset_sync_active_power;
+
+		//Reverse power detection - fast path, checked on each sample
+		int32_t active_power_w= genset_active_power_to_w(genset_global_node_index, active_power);
+		genset_check_reverse_power(genset_global_node_index, active_power_w);
+
+		//Energy integration - sample timestamp from the modbus engine
+		int64_t energy= energy_integrate(&genset_nodes[genset_global_node_index].node_energy,
+				active_power_w, genset_node.getResponseTime());
+		genset_energy_total+= energy;
+		load_energy_total+= energy;
 
 		//Update communication status - transaction success
 		genset_update_communication_status(genset_global_node_index, true);
@@ -306,17 +528,13 @@ void genset_successful_transaction(){
 		genset_variable_modbus&= ~genset_sync_active_power;
 	}
 	else if(genset_variable_modbus & genset_sync_nominal_power){
-		uint32_t nominal_power= 0x00000000;
-		uint16_t register_low= genset_node.getResponseBuffer(0x00);
-		uint16_t register_high= genset_node.getResponseBuffer(0x01);
-
-		//Recovery the entire value
-		nominal_power|= register_high;
-		nominal_power<<= 8;
-		nominal_power|= register_low;
+		//Single register value
+		uint32_t nominal_power= genset_node.getResponseBuffer(0x00);
 
 		//Update Modbus variable
 		genset_nodes[genset_global_node_index].node_modbus_variables.nominal_power= nominal_power;
+		genset_nodes[genset_global_node_index].node_modbus_variables.nominal_power_time= genset_node.getResponseTime();
+		genset_nodes[genset_global_node_index].node_modbus_variables.sampled_variables|= genset_sync_nominal_power;
 
 		//Update communication status - transaction success
 		genset_update_communication_status(genset_global_node_index, true);
@@ -327,6 +545,29 @@ void genset_successful_transaction(){
 		//Reset flag
 		genset_variable_modbus&= ~genset_sync_nominal_power;
 	}
+	else if(genset_variable_modbus & genset_sync_breakers){
+		volatile _genset_node_modbus_data *data= &genset_nodes[genset_global_node_index].node_modbus_variables;
+		uint16_t breakers_status= genset_node.getResponseBuffer(0x00);
+
+		//First sample or some breaker changed - signal the transition immediately
+		if(!(data->sampled_variables & genset_sync_breakers) || (breakers_status != data->breakers_status))
+			genset_flag_sync|= genset_sync_breakers;
+
+		//Update Modbus variable
+		data->breakers_status= breakers_status;
+		data->breakers_time= genset_node.getResponseTime();
+		data->sampled_variables|= genset_sync_breakers;
+
+		//Genset off the bus - no reverse power possible
+		if(genset_gcb_opened(genset_global_node_index))
+			genset_reverse_power_disarm(genset_global_node_index);
+
+		//Update communication status - transaction success
+		genset_update_communication_status(genset_global_node_index, true);
+
+		//Reset flag
+		genset_variable_modbus&= ~genset_sync_breakers;
+	}
 }
 
 /*------------------------------------------------------------------
@@ -347,6 +588,10 @@ void genset_timeout_transaction(){
 		//Reset flag
 		genset_variable_modbus&= ~genset_sync_nominal_power;
 	}
+	else if(genset_variable_modbus & genset_sync_breakers){
+		//Reset flag
+		genset_variable_modbus&= ~genset_sync_breakers;
+	}
 }
 
 /*-----------------------------------------------------------------
@@ -417,6 +662,41 @@ uint8_t genset_read_nominal_power(uint8_t node_index){
 	return(genset_node.readInputRegisters(register_to_read, number_of_registers));
 }
 
+/*-----------------------------------------------------------------
+ * Read circuit breakers status from specified node
+ * All breakers share the same register on the supported controllers
+ * ----------------------------------------------------------------*/
+uint8_t genset_read_breakers(uint8_t node_index){
+	//Verifies the index
+	if(node_index >= genset_max_nodes)
+			return(transaction_timeout);
+
+	uint16_t register_to_read= 0;
+	uint8_t number_of_registers= 0;
+
+	//Set the destination node address
+	genset_node.setSlaveAddr(genset_nodes[node_index].node_addr);
+
+	//Set Modbus start register and number of registers to be read
+	switch (genset_nodes[node_index].node_type) {
+		case NoGenset:
+				return(transaction_timeout);
+			break;
+		case Sices:
+				register_to_read= Sices::gcb_status;
+				number_of_registers= Sices::gcb_status_nr;
+			break;
+		default:
+				return(transaction_timeout);
+			break;
+	}
+
+	genset_global_node_index= node_index; 				//Save the node that is communicating
+	genset_variable_modbus|= genset_sync_breakers; 		//Set the variable that is being read
+	//Non-blocking function
+	return(genset_node.readInputRegisters(register_to_read, number_of_registers));
+}
+
 
 /*------------------------------------------------------------------
  *Update node communication status
@@ -441,7 +721,14 @@ void genset_update_communication_status(uint8_t node_index, bool sucess){
 			else{
 				if(++genset_nodes[node_index].node_comm_error_counter == genset_max_comm_errors){
 					genset_nodes[node_index].node_communication_status= disconnected;
+					energy_gap(&genset_nodes[node_index].node_energy);
+					soe_record(soe_genset_comm, node_index, disconnected, micros());
 					genset_flag_sync|= genset_sync_comm_status;
+					//Reverse power condition of the node no longer known
+					genset_reverse_power_disarm(node_index);
+					//Breakers status of the node no longer valid
+					if(genset_nodes[node_index].node_modbus_variables.sampled_variables & genset_sync_breakers)
+						genset_flag_sync|= genset_sync_breakers;
 				}
 			}
 			break;
@@ -450,10 +737,118 @@ void genset_update_communication_status(uint8_t node_index, bool sucess){
 					genset_nodes[node_index].node_comm_error_counter--;
 					genset_nodes[node_index].node_communication_status= timeout;
 					genset_flag_sync|= genset_sync_comm_status;
+					soe_record(soe_genset_comm, node_index, timeout, micros());
+					//Breakers status of the node valid again
+					if(genset_nodes[node_index].node_modbus_variables.sampled_variables & genset_sync_breakers)
+						genset_flag_sync|= genset_sync_breakers;
 				}
 			break;
 	}
 }
 
+/*------------------------------------------------------------------
+ *Convert the @active_power received from @node_index to W
+ *----------------------------------------------------------------*/
+int32_t genset_active_power_to_w(uint8_t node_index, uint32_t active_power){
+	switch (genset_nodes[node_index].node_type) {
+		case Sices:
+				return((int32_t)(((int64_t)(int32_t)active_power * Sices::active_power_w_mul) / Sices::active_power_w_div));
+			break;
+		default:
+				return(0);
+			break;
+	}
+}
+
+/*------------------------------------------------------------------
+ *Convert the @nominal_power received from @node_index to W
+ *----------------------------------------------------------------*/
+int32_t genset_nominal_power_to_w(uint8_t node_index, uint32_t nominal_power){
+	switch (genset_nodes[node_index].node_type) {
+		case Sices:
+				return((int32_t)(((int64_t)nominal_power * Sices::nominal_power_w_mul) / Sices::nominal_power_w_div));
+			break;
+		default:
+				return(0);
+			break;
+	}
+}
+
+/*------------------------------------------------------------------
+ *Check the @active_power [W] of @node_index against the reverse power
+ *threshold - called on each active power sample
+ *Only a running genset is checked: armed when loaded above twice the
+ *threshold, disarmed when its GCB opens, when it is disconnected or
+ *after genset_reverse_power_disarm_time below twice the threshold (genset
+ *stopped with the controller answering); negative power always trips
+ *The node stays signaled until it is loaded again or disarmed
+ *----------------------------------------------------------------*/
+void genset_check_reverse_power(uint8_t node_index, int32_t active_power){
+	uint32_t node_mask= ((uint32_t)1 << node_index);
+	int32_t nominal_power= genset_nominal_power_to_w(node_index, genset_nodes[node_index].node_modbus_variables.nominal_power);
+	int32_t threshold= (int32_t)(((int64_t)nominal_power * genset_reverse_power_threshold) / 1000);
+	uint32_t now= millis();
+
+	//Genset off the bus - no reverse power possible
+	if(genset_gcb_opened(node_index)){
+		genset_reverse_power_disarm(node_index);
+		return;
+	}
+
+	//Loaded genset
+	if(active_power > (2 * threshold)){
+		genset_nodes[node_index].reverse_power_armed= true;
+		genset_nodes[node_index].reverse_power_running_time= now;
+		genset_reverse_power_nodes&= ~node_mask;
+		return;
+	}
+
+	//Not running for too long - stopped or unloaded genset
+	if(genset_nodes[node_index].reverse_power_armed &&
+	   ((uint32_t)(now - genset_nodes[node_index].reverse_power_running_time) >= genset_reverse_power_disarm_time))
+		genset_reverse_power_disarm(node_index);
+
+	//Active power approaching zero or negative
+	if((active_power <= threshold) &&
+	   (genset_nodes[node_index].reverse_power_armed || (active_power < 0))){
+		//New detection
+		if(!(genset_reverse_power_nodes & node_mask)){
+			genset_reverse_power_nodes|= node_mask;
+			genset_reverse_power_time= micros();
+		}
+		//Each sample in the condition extends the protection hold
+		genset_flag_sync|= genset_sync_reverse_power;
+	}
+}
+
+/*------------------------------------------------------------------
+ *Stop the reverse power detection of @node_index until it is loaded
+ *again - the node is no longer signaled
+ *----------------------------------------------------------------*/
+void genset_reverse_power_disarm(uint8_t node_index){
+	genset_nodes[node_index].reverse_power_armed= false;
+	genset_reverse_power_nodes&= ~((uint32_t)1 << node_index);
+}
+
+/*------------------------------------------------------------------
+ *Return true if @node_index reported its GCB opened (genset off the bus)
+ *----------------------------------------------------------------*/
+bool genset_gcb_opened(uint8_t node_index){
+	volatile _genset_node_modbus_data *data= &genset_nodes[node_index].node_modbus_variables;
+
+	//Status never read
+	if(!(data->sampled_variables & genset_sync_breakers))
+		return(false);
+
+	switch (genset_nodes[node_index].node_type) {
+		case Sices:
+				return(!(data->breakers_status & Sices::gcb_status_mask));
+			break;
+		default:
+				return(false);
+			break;
+	}
+}
+
 
 #endif /* GENSET_MODBUS_H_ */
@@ -12,8 +12,11 @@
 
 #define ARDUINO_DUE
 
+//Loop profiler (DWT cycle counter) - uncomment to add the profiler code
+//#define PROFILER_ENABLED
+
 //Default baud rate used for RS485 serial ports
-static const uint16_t default_baud_rate= 115200;
+static const uint32_t default_baud_rate= 115200;
 
 //=========================RS485 - PV SYSTEM SERIAL COMMUNICATION=========================//
 //19 (RX) -  18 (TX)
@@ -29,7 +32,14 @@ static const uint8_t genset_serial_port_re=	24;
 static const uint8_t genset_serial_port_de=	25;
 //=========================RS485 - GENSET SERIAL COMMUNICATION============================//
 
+//==========================DISPLAY - SERIAL CHARACTER LCD 20x4========================//
+//15 (RX) - 14 (TX)
+#define display_serial_port Serial3
+static const uint32_t display_baud_rate= 19200;
+//==========================DISPLAY - SERIAL CHARACTER LCD 20x4========================//
+
 //======================================DIGITAL INPUTS===================================//
+//26 (PD1) - 27 (PD2) - 28 (PD3) - 29 (PD6): all on PIOD, sampled in one port read
 static const uint8_t digital_input1= 26;
 static const uint8_t digital_input2= 27;
 static const uint8_t digital_input3= 28;
@@ -44,6 +54,7 @@ static const uint8_t digital_output4= 33;
 //=====================================DIGITAL OUTPUTS===================================//
 
 //=====================================ANALOGUE INPUTS===================================//
+//A0 (AD7) - A1 (AD6) - A2 (AD5) - A3 (AD4): scanned by the ADC in one sequence
 static const uint8_t analogue_input1= A0;
 static const uint8_t analogue_input2= A1;
 static const uint8_t analogue_input3= A2;
@@ -51,6 +62,7 @@ static const uint8_t analogue_input4= A3;
 //=====================================ANALOGUE INPUTS===================================//
 
 //=======================================KEY BUTTONS=====================================//
+//34 (PC2) - 35 (PC3) - 36 (PC4) - 37 (PC5) - 38 (PC6) - 39 (PC7): all on PIOC, scanned in one port read
 static const uint8_t button_left  =	34;
 static const uint8_t button_right =	35;
 static const uint8_t button_down  =	36;
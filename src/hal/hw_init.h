@@ -16,6 +16,8 @@
 #include "../digital_outputs.h"
 #include "../analog_inputs.h"
 #include "../keyboard.h"
+#include "../display.h"
+#include "../profiler.h"
 
 /*------------------------------------------------------------------
  * Initialize all board hardware configuration
@@ -41,6 +43,15 @@ void hw_init(){
 //=======================================KEY BUTTONS=====================================//
 	init_keyboard();
 //=======================================KEY BUTTONS=====================================//
+
+//========================================DISPLAY========================================//
+	display_serial_port.begin(display_baud_rate);
+	init_display(&display_serial_port);
+//========================================DISPLAY========================================//
+
+//=======================================PROFILER========================================//
+	profiler_init();
+//=======================================PROFILER========================================//
 }
 
 #endif /* HW_INIT_H_ */
@@ -14,6 +14,14 @@
 #include "../pv_modbus.h"
 #include "../genset_modbus.h"
 #include "../digital_inputs_functions.h"
+#include "../breakers.h"
+#include "../dispatcher.h"
+#include "../curtailment.h"
+#include "../protection.h"
+#include "../operating_mode.h"
+#include "../failsafe.h"
+#include "../sequence_of_events.h"
+#include "../menu.h"
 
 /*------------------------------------------------------------------
  * 						HEADERS
@@ -39,14 +47,39 @@
  * ----------------------------------------------------------------*/
 
 void sw_init(){
+	//Init sequence of events recorder (before the modules that record events)
+	soe_init();
+
 	//Init PV system modbus interface
 	pv_init_modbus(pv_default_slave_addr);
 
 	//Init Genset modbus interface
 	genset_init_modbus(genset_default_slave_addr);
 
+	//Energy delivered to the load (PV + gensets)
+	load_energy_total= 0;
+
 	//Init digital inputs functions
 	di_functions_init();
+	//Init circuit breakers status (genset controllers and digital inputs)
+	breakers_init();
+
+	//Init PV setpoint dispatcher
+	dispatcher_init();
+	//Init PV curtailment control
+	curtailment_init();
+
+	//Init reverse power protection
+	protection_init();
+
+	//Init operating mode manager (grid tied / island)
+	mode_init();
+
+	//Init failsafe supervisor (safe PV limit until the first genset values)
+	failsafe_init();
+
+	//Init operator menu (plant screen)
+	menu_init();
 
 	//Debug port
 	Serial.begin(115200);
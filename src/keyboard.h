@@ -29,12 +29,71 @@ static const uint8_t up_button_mask		= 0x08;
 static const uint8_t enter_button_mask	= 0x10;
 static const uint8_t esc_button_mask	= 0x20;
 
+/**
+ * Hardware pin of each key (bit order of the masks above)
+ * All keys must be on the same PIO port - scanned in one read
+ */
+const uint8_t key_pins[]= {button_left, button_right, button_down, button_up, button_enter, button_esc};
+const uint8_t keys_nr= sizeof(key_pins) / sizeof(key_pins[0]);
+
+/**
+ * Keys scan - the port is read each key_scan_period and a level must be
+ * stable on 4 consecutive scans (vertical counter) to change the key state
+ */
+const uint8_t key_scan_period= 5; //5ms - debounce 20ms
+
+//Key events
+static const uint8_t key_event_press		= 0x01;
+static const uint8_t key_event_release		= 0x02;
+static const uint8_t key_event_long_press	= 0x03;	//Held for key_long_press_time (once per press)
+static const uint8_t key_event_repeat		= 0x04;	//Held - auto-repeat (keys of key_repeat_keys)
+
+//Key held times [ms]
+const uint16_t key_long_press_time= 1000;
+const uint16_t key_repeat_delay= 500;		//First repeat
+const uint16_t key_repeat_period= 150;		//Next repeats
+
+//Keys with auto-repeat (navigation), the others have long press
+const uint8_t key_repeat_keys= left_button_mask | right_button_mask | down_button_mask | up_button_mask;
+
+/**
+ * Event queue size - power of 2, indexes wrap by mask
+ */
+static const uint8_t key_queue_size= 16;
+static const uint8_t key_queue_mask= key_queue_size - 1;
+
 
 /*------------------------------------------------------------------
  * 					GLOBAL VARIABLES
  * ----------------------------------------------------------------*/
-volatile bool keyboard_flag_sync; 	//Flag to indicate that some key was pressed/released
-									//Store key states (pressed/released)
+//Keys with new events since the last management (bit per key)
+volatile uint8_t keyboard_flag_sync;
+
+//Debounced key states (1= pressed)
+uint8_t key_states;
+
+//Port scan and vertical counter debounce (bit per port line)
+Pio *key_port;				//PIO port of the keys
+uint32_t key_port_mask;		//Port lines used as keys
+uint32_t key_port_lines[keys_nr]; //Port line of each key
+uint32_t key_port_states;	//Debounced port lines (1= pressed)
+uint32_t key_counter_0;		//Vertical counter - bit 0
+uint32_t key_counter_1;		//Vertical counter - bit 1
+
+//Key held timing
+uint32_t key_repeat_time[keys_nr];	//Next repeat or long press [ms]
+uint8_t key_long_sent;				//Long press already sent (bit per key)
+
+//Event queue - written only by the scan, read only by the UI
+typedef struct{
+	uint8_t key;		//Key index (bit order of the masks)
+	uint8_t type;		//key_event_*
+}_key_event;
+
+_key_event key_queue[key_queue_size];
+volatile uint8_t key_queue_head;
+volatile uint8_t key_queue_tail;
+volatile uint16_t key_queue_overflows;	//Events lost with the queue full
 
 
 /*------------------------------------------------------------------
@@ -46,39 +105,22 @@ volatile bool keyboard_flag_sync; 	//Flag to indicate that some key was pressed/
 void init_keyboard();
 
 /*------------------------------------------------------------------
- * ISR - LEFT button pressed
+ * Queue a key event - scan side
  * ----------------------------------------------------------------*/
-void left_changed();
+void key_event_put(uint8_t key, uint8_t type);
 
 /*------------------------------------------------------------------
- * ISR - RIGHT button pressed
+ * Read the oldest key event to @event - UI side
+ * Return false if there is no event
  * ----------------------------------------------------------------*/
-void right_changed();
+bool key_event_get(_key_event *event);
 
 /*------------------------------------------------------------------
- * ISR - DOWN button pressed
+ * Scan all keys in one port read, debounce them and queue the events -
+ * called from main loop each key_scan_period
  * ----------------------------------------------------------------*/
-void down_changed();
+void keyboard_scan();
 
-/*------------------------------------------------------------------
- * ISR - UP button pressed
- * ----------------------------------------------------------------*/
-void up_changed();
-
-/*------------------------------------------------------------------
- * ISR - ENTER button pressed
- * ----------------------------------------------------------------*/
-void enter_changed();
-
-/*------------------------------------------------------------------
- * ISR - ENTER button pressed
- * ----------------------------------------------------------------*/
-void esc_changed();
-
-/*------------------------------------------------------------------
- * Verify the key pressed
- * ----------------------------------------------------------------*/
-void manage_keyboard();
 
 
  /*------------------------------------------------------------------
@@ -86,103 +128,132 @@ void manage_keyboard();
  * ----------------------------------------------------------------*/
 /*------------------------------------------------------------------
  * Initialize the hardware
+ * The keys are scanned from the main loop - no interrupts
  * ----------------------------------------------------------------*/
 void init_keyboard(){
-	pinMode(button_left, INPUT_PULLUP);
-	pinMode(button_right, INPUT_PULLUP);
-	pinMode(button_down, INPUT_PULLUP);
-	pinMode(button_up, INPUT_PULLUP);
-	pinMode(button_enter, INPUT_PULLUP);
-	pinMode(button_esc, INPUT_PULLUP);
+	key_port= g_APinDescription[key_pins[0]].pPort;
+	key_port_mask= 0x00000000;
+
+	for(uint8_t i= 0; i < keys_nr; i++){
+		pinMode(key_pins[i], INPUT_PULLUP);
+
+		//Keys out of the scanned port are not managed
+		key_port_lines[i]= 0x00000000;
+		if(g_APinDescription[key_pins[i]].pPort == key_port)
+			key_port_lines[i]= g_APinDescription[key_pins[i]].ulPin;
+		key_port_mask|= key_port_lines[i];
+
+		key_repeat_time[i]= 0;
+	}
 
 	//Initialize variables to manage the keyboard
-	keyboard_flag_sync&= no_key_pressed;
-
-	//Interrupts
-	//<LEFT>
-	attachInterrupt(digitalPinToInterrupt(button_left), left_changed, FALLING);
-	//<RIGHT>
-	attachInterrupt(digitalPinToInterrupt(button_right), right_changed, FALLING);
-	//<DOWN>
-	attachInterrupt(digitalPinToInterrupt(button_down), down_changed, FALLING);
-	//<UP>
-	attachInterrupt(digitalPinToInterrupt(button_up), up_changed, FALLING);
-	//<ENTER>
-	attachInterrupt(digitalPinToInterrupt(button_enter), enter_changed, FALLING);
-	//<ESC>
-	attachInterrupt(digitalPinToInterrupt(button_esc), esc_changed, FALLING);
+	keyboard_flag_sync= no_key_pressed;
+	key_states= no_key_pressed;
+	key_long_sent= no_key_pressed;
+
+	//Debounce starts from all keys released
+	key_port_states= 0x00000000;
+	key_counter_0= 0x00000000;
+	key_counter_1= 0x00000000;
+
+	key_queue_head= 0;
+	key_queue_tail= 0;
+	key_queue_overflows= 0;
 }
 
 /*------------------------------------------------------------------
- * ISR - LEFT button pressed
+ * Queue a key event - scan side
+ * The event is stored before the head is published; with the queue
+ * full the event is dropped and counted
  * ----------------------------------------------------------------*/
-void left_changed(){
-	if(digitalRead(button_left) == button_pressed)
-		keyboard_flag_sync|= left_button_mask;
-	else
-		keyboard_flag_sync&= ~left_button_mask;
-}
+void key_event_put(uint8_t key, uint8_t type){
+	uint8_t head= key_queue_head;
 
-/*------------------------------------------------------------------
- * ISR - RIGHT button pressed
- * ----------------------------------------------------------------*/
-void right_changed(){
-	keyboard_flag_sync= 1;
+	if((uint8_t)(head - key_queue_tail) >= key_queue_size){
+		key_queue_overflows++;
+		return;
+	}
 
-	if(digitalRead(button_right) == button_pressed)
-		keyboard_flag_sync|= right_button_mask;
-	else
-		keyboard_flag_sync&= ~right_button_mask;
-}
+	key_queue[head & key_queue_mask].key= key;
+	key_queue[head & key_queue_mask].type= type;
 
-/*------------------------------------------------------------------
- * ISR - DOWN button pressed
- * ----------------------------------------------------------------*/
-void down_changed(){
-	if(digitalRead(button_down) == button_pressed)
-		keyboard_flag_sync|= down_button_mask;
-	else
-		keyboard_flag_sync&= ~down_button_mask;
-}
+	//Event stored before the new head (compiler barrier, single core)
+	__asm__ volatile("" ::: "memory");
+	key_queue_head= head + 1;
 
-/*------------------------------------------------------------------
- * ISR - UP button pressed
- * ----------------------------------------------------------------*/
-void up_changed(){
-	if(digitalRead(button_up) == button_pressed)
-		keyboard_flag_sync|= up_button_mask;
-	else
-		keyboard_flag_sync&= ~up_button_mask;
+	keyboard_flag_sync|= (1 << key);
 }
 
 /*------------------------------------------------------------------
- * ISR - ENTER button pressed
+ * Read the oldest key event to @event - UI side
+ * Return false if there is no event
  * ----------------------------------------------------------------*/
-void enter_changed(){
-	if(digitalRead(button_enter) == button_pressed)
-		keyboard_flag_sync|= enter_button_mask;
-	else
-		keyboard_flag_sync&= ~enter_button_mask;
-}
+bool key_event_get(_key_event *event){
+	uint8_t tail= key_queue_tail;
 
-/*------------------------------------------------------------------
- * ISR - ESC button pressed
- * ----------------------------------------------------------------*/
-void esc_changed(){
-	if(digitalRead(button_esc) == button_pressed)
-		keyboard_flag_sync|= esc_button_mask;
-	else
-		keyboard_flag_sync&= ~esc_button_mask;
-}
+	if(tail == key_queue_head)
+		return(false);
+
+	//Head read before the event (compiler barrier, single core)
+	__asm__ volatile("" ::: "memory");
+	*event= key_queue[tail & key_queue_mask];
 
+	//Event copied before the slot is released to the scan
+	__asm__ volatile("" ::: "memory");
+	key_queue_tail= tail + 1;
+
+	return(true);
+}
 
 /*------------------------------------------------------------------
- * Verify the key pressed
+ * Scan all keys in one port read, debounce them and queue the events -
+ * called from main loop each key_scan_period
+ * Vertical counter: same debounce of the digital inputs (4 scans)
+ * Keys held: long press once, or auto-repeat for key_repeat_keys
  * ----------------------------------------------------------------*/
-void manage_keyboard(){
-	keyboard_flag_sync= 0;
-
-	Serial.println(keyboard_flag_sync);
+void keyboard_scan(){
+	uint32_t now= millis();
+
+	//Pressed lines (keys pressed at LOW level)
+	uint32_t sample= ~key_port->PIO_PDSR & key_port_mask;
+
+	uint32_t delta= sample ^ key_port_states;
+	key_counter_1= (key_counter_1 ^ key_counter_0) & delta;
+	key_counter_0= ~key_counter_0 & delta;
+	uint32_t toggle= delta & ~(key_counter_0 | key_counter_1);
+	key_port_states^= toggle;
+
+	for(uint8_t i= 0; i < keys_nr; i++){
+		uint8_t mask= (1 << i);
+
+		//Press and release
+		if(toggle & key_port_lines[i]){
+			if(key_port_states & key_port_lines[i]){
+				key_states|= mask;
+				key_long_sent&= ~mask;
+				key_repeat_time[i]= now + ((mask & key_repeat_keys) ? key_repeat_delay : key_long_press_time);
+				key_event_put(i, key_event_press);
+			}
+			else{
+				key_states&= ~mask;
+				key_event_put(i, key_event_release);
+			}
+			continue;
+		}
+
+		//Key held
+		if(!(key_states & mask) || ((int32_t)(now - key_repeat_time[i]) < 0))
+			continue;
+
+		if(mask & key_repeat_keys){
+			key_repeat_time[i]= now + key_repeat_period;
+			key_event_put(i, key_event_repeat);
+		}
+		else if(!(key_long_sent & mask)){
+			key_long_sent|= mask;
+			key_event_put(i, key_event_long_press);
+		}
+	}
 }
 
 
@@ -63,7 +63,7 @@ obtain a copy.
 #ifndef MODBUS_CRC16_H_
 #define MODBUS_CRC16_H_
 
-static uint16_t crc16_update(uint16_t crc, uint8_t a)
+static inline uint16_t crc16_update(uint16_t crc, uint8_t a)
 {
   int i;
 
@@ -46,6 +46,19 @@ ModbusMaster::ModbusMaster(void)
   _postTransmission = 0;
 
   ku16MBResponseTimeout= 2000;
+  _u16TurnaroundDelay= 100;
+  _u32ResponseTime= 0;
+
+  _u8ModbusADUSize = 0;
+  _u32StartTime = 0;
+  _u8BytesLeft = 8;
+  _u8MBStatus = ku8MBSuccess;
+  _u8TransactionStatus = transaction_idle;
+
+  _u8ClassRequests = 0;
+  _u8ActiveClass = ku8MBNoClass;
+  _u16StarvationTime = 1000;
+  clearQueueStatistics();
 }
 
 /**
@@ -81,7 +94,7 @@ void ModbusMaster::beginTransmission(uint16_t u16Address)
 // eliminate this function in favor of using existing MB request functions
 uint8_t ModbusMaster::requestFrom(uint16_t address, uint16_t quantity)
 {
-  uint8_t read;
+  uint8_t read = 0;
   // clamp to buffer length
   if (quantity > ku8MaxBufferSize)
   {
@@ -216,15 +229,20 @@ void ModbusMaster::setTimeout(uint16_t new_timeout){
 	this->ku16MBResponseTimeout= new_timeout;
 }
 
+/**
+ * Set the turnaround delay after a broadcast request
+ * No request is sent to the bus while the slaves process the broadcast
+ */
+void ModbusMaster::setTurnaroundDelay(uint16_t new_delay){
+	this->_u16TurnaroundDelay= new_delay;
+}
+
 /**
  * Set Modbus slave address for next Modbus transaction
+ * Address 0 (ku8MBBroadcastAddress) sends the next write to all slaves
  */
 void ModbusMaster::setSlaveAddr(uint8_t addr){
-	if(addr == 0){
-		this->_u8MBSlave= 1; //Default value
-	}
-	else
-		this->_u8MBSlave= addr;
+	this->_u8MBSlave= addr;
 }
 
 /**
@@ -247,6 +265,196 @@ uint16_t ModbusMaster::getResponseBuffer(uint8_t u8Index)
 }
 
 
+/**
+Retrieve the sample timestamp of the response buffer.
+Time (millis()) at which the last valid response was received; use it
+to timestamp the values read from the response buffer.
+@return timestamp of the last valid response [ms]
+@ingroup buffer
+*/
+uint32_t ModbusMaster::getResponseTime()
+{
+  return _u32ResponseTime;
+}
+
+
+/**
+Retrieve the state of the ongoing transaction.
+A new transaction may only be started when the state is transaction_idle
+or transaction_timeout.
+@return transaction_idle, transaction_receveing or transaction_timeout
+@ingroup buffer
+*/
+uint8_t ModbusMaster::getTransactionStatus()
+{
+  return _u8TransactionStatus;
+}
+
+
+/**
+Signal that a priority class has a transaction waiting for the bus.
+Call it while the class has work; the waiting time is counted from the
+first call until the class starts a transaction.
+@param u8Class priority class (0..ku8MBPriorityClasses-1, 0= highest)
+@ingroup arbitration
+*/
+void ModbusMaster::requestClass(uint8_t u8Class)
+{
+  if (u8Class >= ku8MBPriorityClasses)
+  {
+    return;
+  }
+
+  if (!bitRead(_u8ClassRequests, u8Class))
+  {
+    bitSet(_u8ClassRequests, u8Class);
+    _u32RequestTime[u8Class] = micros();
+    _u8QueueWait[u8Class] = 0;
+  }
+}
+
+
+/**
+Withdraw the request of a priority class without work left.
+@param u8Class priority class (0..ku8MBPriorityClasses-1, 0= highest)
+@ingroup arbitration
+*/
+void ModbusMaster::releaseClass(uint8_t u8Class)
+{
+  if (u8Class < ku8MBPriorityClasses)
+  {
+    bitClear(_u8ClassRequests, u8Class);
+  }
+}
+
+
+/**
+Select the priority class allowed to drive the bus.
+While a transaction is ongoing its class keeps the bus; on a transaction
+boundary the highest priority class waiting is granted (strict
+preemption). Below class 0, a class that has waited longer than the
+starvation time is granted first (the longest waiting one), so a busy
+higher class can not hold off the others indefinitely.
+@return granted class or ku8MBNoClass if no class is waiting
+@ingroup arbitration
+*/
+uint8_t ModbusMaster::grantClass()
+{
+  uint8_t i;
+
+  // ongoing transaction - the class keeps the bus until the answer
+  if (_u8TransactionStatus == transaction_receveing)
+  {
+    return _u8ActiveClass;
+  }
+
+  _u8ActiveClass = ku8MBNoClass;
+
+  // starvation protection below class 0 - longest waiting class first
+  if (!bitRead(_u8ClassRequests, 0))
+  {
+    uint32_t u32Now = micros();
+    uint32_t u32Oldest = (uint32_t)_u16StarvationTime * 1000;
+
+    for (i = 1; i < ku8MBPriorityClasses; i++)
+    {
+      if (bitRead(_u8ClassRequests, i) && ((u32Now - _u32RequestTime[i]) > u32Oldest))
+      {
+        u32Oldest = u32Now - _u32RequestTime[i];
+        _u8ActiveClass = i;
+      }
+    }
+    if (_u8ActiveClass != ku8MBNoClass)
+    {
+      return _u8ActiveClass;
+    }
+  }
+
+  for (i = 0; i < ku8MBPriorityClasses; i++)
+  {
+    if (bitRead(_u8ClassRequests, i))
+    {
+      _u8ActiveClass = i;
+      break;
+    }
+  }
+
+  return _u8ActiveClass;
+}
+
+
+/**
+Set the starvation time of the priority classes below class 0.
+@param new_time waiting time after which a class is granted first [milliseconds]
+@ingroup arbitration
+*/
+void ModbusMaster::setStarvationTime(uint16_t new_time)
+{
+  _u16StarvationTime = new_time;
+}
+
+
+/**
+Retrieve the last queueing delay of a priority class.
+@return request to transaction start delay [microseconds]
+@ingroup arbitration
+*/
+uint32_t ModbusMaster::getQueueDelayLast(uint8_t u8Class)
+{
+  return (u8Class < ku8MBPriorityClasses) ? _u32QueueDelayLast[u8Class] : 0;
+}
+
+
+/**
+Retrieve the maximum queueing delay of a priority class.
+@return request to transaction start delay [microseconds]
+@ingroup arbitration
+*/
+uint32_t ModbusMaster::getQueueDelayMax(uint8_t u8Class)
+{
+  return (u8Class < ku8MBPriorityClasses) ? _u32QueueDelayMax[u8Class] : 0;
+}
+
+
+/**
+Retrieve the maximum number of transactions of other classes started
+while a priority class was waiting.
+@ingroup arbitration
+*/
+uint8_t ModbusMaster::getQueueWaitMax(uint8_t u8Class)
+{
+  return (u8Class < ku8MBPriorityClasses) ? _u8QueueWaitMax[u8Class] : 0;
+}
+
+
+/**
+Retrieve the number of transactions started by a priority class.
+@ingroup arbitration
+*/
+uint32_t ModbusMaster::getQueueGrants(uint8_t u8Class)
+{
+  return (u8Class < ku8MBPriorityClasses) ? _u32QueueGrants[u8Class] : 0;
+}
+
+
+/**
+Clear the queueing statistics of all priority classes.
+@ingroup arbitration
+*/
+void ModbusMaster::clearQueueStatistics()
+{
+  uint8_t i;
+
+  for (i = 0; i < ku8MBPriorityClasses; i++)
+  {
+    _u32QueueDelayLast[i] = 0;
+    _u32QueueDelayMax[i] = 0;
+    _u8QueueWaitMax[i] = 0;
+    _u32QueueGrants[i] = 0;
+  }
+}
+
+
 /**
 Clear Modbus response buffer.
 @see ModbusMaster::getResponseBuffer(uint8_t u8Index)
@@ -572,19 +780,61 @@ Sequence:
 */
 uint8_t ModbusMaster::ModbusMasterTransaction(uint8_t u8MBFunction)
 {
-  uint8_t u8ModbusADU[256];
-  static uint8_t u8ModbusADUSize = 0;
+  //Transaction state is kept per object - each bus runs independently
+  uint8_t *u8ModbusADU = _u8ModbusADU;
+  uint8_t &u8ModbusADUSize = _u8ModbusADUSize;
   uint8_t i, u8Qty;
   uint16_t u16CRC;
-  static uint32_t u32StartTime= 0;
-  static uint8_t u8BytesLeft = 8;
-  static uint8_t u8MBStatus = ku8MBSuccess;
+  uint32_t &u32StartTime = _u32StartTime;
+  uint8_t &u8BytesLeft = _u8BytesLeft;
+  uint8_t &u8MBStatus = _u8MBStatus;
 
   //Control the state of transaction
-  static uint8_t transaction_status= transaction_idle;
+  uint8_t &transaction_status = _u8TransactionStatus;
 
   //Initial state or timeout for previous query
   if((transaction_status == transaction_idle) || (transaction_status == transaction_timeout)){
+	  //Broadcast is write only - no slave answers a read request
+	  if(_u8MBSlave == ku8MBBroadcastAddress){
+		  switch(u8MBFunction)
+		  {
+			case ku8MBReadCoils:
+			case ku8MBReadDiscreteInputs:
+			case ku8MBReadInputRegisters:
+			case ku8MBReadHoldingRegisters:
+			case ku8MBReadWriteMultipleRegisters:
+			  transaction_status= transaction_timeout;
+			  return(transaction_status);
+		  }
+	  }
+
+	  // queueing statistics - the granted class starts its transaction
+	  if (_u8ActiveClass < ku8MBPriorityClasses)
+	  {
+		for (i = 0; i < ku8MBPriorityClasses; i++)
+		{
+		  if ((i != _u8ActiveClass) && bitRead(_u8ClassRequests, i) && (_u8QueueWait[i] < 0xFF))
+		  {
+			_u8QueueWait[i]++;
+		  }
+		}
+
+		if (bitRead(_u8ClassRequests, _u8ActiveClass))
+		{
+		  bitClear(_u8ClassRequests, _u8ActiveClass);
+		  _u32QueueDelayLast[_u8ActiveClass] = micros() - _u32RequestTime[_u8ActiveClass];
+		  if (_u32QueueDelayLast[_u8ActiveClass] > _u32QueueDelayMax[_u8ActiveClass])
+		  {
+			_u32QueueDelayMax[_u8ActiveClass] = _u32QueueDelayLast[_u8ActiveClass];
+		  }
+		  if (_u8QueueWait[_u8ActiveClass] > _u8QueueWaitMax[_u8ActiveClass])
+		  {
+			_u8QueueWaitMax[_u8ActiveClass] = _u8QueueWait[_u8ActiveClass];
+		  }
+		}
+		_u32QueueGrants[_u8ActiveClass]++;
+	  }
+
 	  // assemble Modbus Request Application Data Unit
 	  u8ModbusADU[u8ModbusADUSize++] = _u8MBSlave;
 	  u8ModbusADU[u8ModbusADUSize++] = u8MBFunction;
@@ -709,6 +959,27 @@ uint8_t ModbusMaster::ModbusMasterTransaction(uint8_t u8MBFunction)
 	  return(transaction_status);
   }
 
+  //Broadcast - no answer, wait the turnaround delay before the next request
+  if((transaction_status == transaction_receveing) && (_u8MBSlave == ku8MBBroadcastAddress)){
+	  if((millis() - u32StartTime) < _u16TurnaroundDelay){
+		  return(transaction_status);
+	  }
+
+	  transaction_status= transaction_idle;
+	  //Restart class control variables
+	  _u8TransmitBufferIndex = 0;
+	  u16TransmitBufferLength = 0;
+	  _u8ResponseBufferIndex = 0;
+
+	  //Callback function - request executed by the slaves
+	  _u32ResponseTime= millis();
+	  if(_querySuccess){
+		  _querySuccess();
+	  }
+
+	  return(transaction_status);
+  }
+
   // Waiting for answer
   if(transaction_status == transaction_receveing){
 	  // Verifies if all bytes was received and no Modbus error
@@ -851,6 +1122,7 @@ uint8_t ModbusMaster::ModbusMasterTransaction(uint8_t u8MBFunction)
 
 			//Callback function
 			if(u8MBStatus == ku8MBSuccess){
+				  _u32ResponseTime= millis();
 				  if(_querySuccess){
 					  _querySuccess();
 				  }
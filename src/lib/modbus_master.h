@@ -12,6 +12,7 @@ Arduino library for communicating with Modbus slaves over RS232/485 (via RTU pro
 @defgroup discrete Modbus Function Codes for Discrete Coils/Inputs
 @defgroup register Modbus Function Codes for Holding/Input Registers
 @defgroup constant Modbus Function Codes, Exception Codes
+@defgroup arbitration ModbusMaster Bus Arbitration by Priority Class
 */
 /*
   ModbusMaster.h - Arduino library for communicating with Modbus slaves
@@ -78,8 +79,42 @@ class ModbusMaster
     void queryTimeout(void (*)());
 
     void setTimeout(uint16_t new_timeout);
+    void setTurnaroundDelay(uint16_t new_delay);
     void setSlaveAddr(uint8_t addr);
 
+    /**
+    Modbus broadcast address.
+    Requests sent to this address are executed by all slaves and never
+    answered; only write functions can be broadcast.
+    @ingroup constant
+    */
+    static const uint8_t ku8MBBroadcastAddress           = 0x00;
+
+    // Bus arbitration - priority classes (0= highest priority)
+    /**
+    Number of priority classes for bus arbitration.
+    Class 0 has the highest priority and always preempts; the other
+    classes are protected against starvation.
+    @ingroup arbitration
+    */
+    static const uint8_t ku8MBPriorityClasses            = 4;
+
+    /**
+    No priority class waiting for the bus.
+    @ingroup arbitration
+    */
+    static const uint8_t ku8MBNoClass                    = 0xFF;
+
+    void     requestClass(uint8_t u8Class);
+    void     releaseClass(uint8_t u8Class);
+    uint8_t  grantClass();
+    void     setStarvationTime(uint16_t new_time);
+    uint32_t getQueueDelayLast(uint8_t u8Class);
+    uint32_t getQueueDelayMax(uint8_t u8Class);
+    uint8_t  getQueueWaitMax(uint8_t u8Class);
+    uint32_t getQueueGrants(uint8_t u8Class);
+    void     clearQueueStatistics();
+
     // Modbus exception codes
     /**
     Modbus protocol illegal function exception.
@@ -193,6 +228,8 @@ class ModbusMaster
     static const uint8_t ku8MBInvalidCRC                 = 0xE3;
 
     uint16_t getResponseBuffer(uint8_t);
+    uint32_t getResponseTime();
+    uint8_t  getTransactionStatus();
     void     clearResponseBuffer();
     uint8_t  setTransmitBuffer(uint8_t, uint16_t);
     void     clearTransmitBuffer();
@@ -223,7 +260,7 @@ class ModbusMaster
 
   private:
     Stream* _serial;                                             ///< reference to serial port object
-    uint8_t  _u8MBSlave;                                         ///< Modbus slave (1..255) initialized in begin()
+    uint8_t  _u8MBSlave;                                         ///< Modbus slave (1..247, 0= broadcast) initialized in begin()
     static const uint8_t ku8MaxBufferSize                = 64;   ///< size of response/transmit buffers
     uint16_t _u16ReadAddress;                                    ///< slave register from which to read
     uint16_t _u16ReadQty;                                        ///< quantity of words to read
@@ -237,6 +274,26 @@ class ModbusMaster
     uint16_t* rxBuffer; // from Wire.h -- need to clean this up Rx
     uint8_t _u8ResponseBufferIndex;
     uint8_t _u8ResponseBufferLength;
+    uint32_t _u32ResponseTime;                                   ///< millis() when the last valid response was received
+
+    // state of the ongoing non-blocking transaction
+    uint8_t  _u8ModbusADU[256];                                  ///< request/response Application Data Unit
+    uint8_t  _u8ModbusADUSize;                                   ///< bytes in _u8ModbusADU
+    uint32_t _u32StartTime;                                      ///< millis() when the request was sent
+    uint8_t  _u8BytesLeft;                                       ///< response bytes still expected
+    uint8_t  _u8MBStatus;                                        ///< status of the ongoing transaction
+    uint8_t  _u8TransactionStatus;                               ///< transaction_idle, transaction_receveing or transaction_timeout
+
+    // bus arbitration by priority class
+    uint8_t  _u8ClassRequests;                                   ///< classes waiting for the bus (bit per class)
+    uint8_t  _u8ActiveClass;                                     ///< class granted on the last transaction boundary
+    uint16_t _u16StarvationTime;                                 ///< class waiting longer is granted first [milliseconds]
+    uint32_t _u32RequestTime[ku8MBPriorityClasses];              ///< micros() when each class started waiting
+    uint8_t  _u8QueueWait[ku8MBPriorityClasses];                 ///< transactions of other classes started while waiting
+    uint32_t _u32QueueDelayLast[ku8MBPriorityClasses];           ///< last request to transaction start delay [microseconds]
+    uint32_t _u32QueueDelayMax[ku8MBPriorityClasses];            ///< maximum request to transaction start delay [microseconds]
+    uint8_t  _u8QueueWaitMax[ku8MBPriorityClasses];              ///< maximum transactions waited
+    uint32_t _u32QueueGrants[ku8MBPriorityClasses];              ///< transactions started by each class
 
     // Modbus function codes for bit access
     static const uint8_t ku8MBReadCoils                  = 0x01; ///< Modbus function 0x01 Read Coils
@@ -255,6 +312,8 @@ class ModbusMaster
     // Modbus timeout [milliseconds]
     //static const uint16_t ku16MBResponseTimeout          = 2000; ///< Modbus timeout [milliseconds]
     uint16_t ku16MBResponseTimeout;//          = 2000; ///< Modbus timeout [milliseconds]
+    // Delay after a broadcast request - time for the slaves to process it [milliseconds]
+    uint16_t _u16TurnaroundDelay;
 
     // master function that conducts Modbus transactions
     uint8_t ModbusMasterTransaction(uint8_t u8MBFunction);
@@ -10,7 +10,7 @@
  * External global synchronization variables
  * ----------------------------------------------------------------*/
 //keyboard.h
-extern volatile bool keyboard_flag_sync; //Keyboard some key was pressed synchronization flag
+extern volatile uint8_t keyboard_flag_sync; //Keyboard keys with new events synchronization flag
 //pv_modbus.h
 extern uint16_t pv_flag_sync; 			//Modbus new data available synchronization flag
 //genset_modbus.h
@@ -40,6 +40,8 @@ void setup() {
 void loop() {
 	//Resource management interval control variable
 	static unsigned long prev_millis   = 0;
+	//Control task interval control variable
+	static unsigned long prev_millis_control= 0;
 	//Count the time for resource management scheduler
 	static uint16_t time_ms= 0;
 
@@ -49,6 +51,8 @@ void loop() {
 	static unsigned long main_loop_iteraction_count = 0;
 	static unsigned long prev_micros_main_loop = 0;
 
+	PROF_BEGIN(prof_loop);
+
 //------------------- TIME LAPSE COMPUTATION -----------------------
 	//Main loop - time lapse average sum
 	main_loop_time_average_sum+= (unsigned long)(micros() - prev_micros_main_loop);
@@ -66,30 +70,86 @@ void loop() {
 		//The value for resources management is restricted to 1 second (1000ms)
 		time_ms > 1000 ? time_ms= 0 : time_ms++;
 
-		//Scheduler for modbus variables reading
-		const uint8_t scheduler_read_genset= 	0x00;    //Read genset controller node
-		const uint8_t scheduler_read_pv= 		0x01;    //Read PV inverter node
-
-		static uint8_t scheduler= scheduler_read_genset; //Scheduler for node modbus read
-		static uint8_t pv_node_read= 		0; 			 //Set pv node index to read
+		//Scheduler for modbus transactions - each bus runs independently
+		static uint8_t pv_node_fast= 		0; 			 //Set pv node index to read active power
+		static uint8_t pv_node_slow= 		0; 			 //Set pv node index to read nominal power
 		static uint8_t genset_node_read= 	0;			 //Set genset node index to read
-		switch(scheduler){
-			case scheduler_read_genset:
-				//Actual node modbus variables transactions was finished
-				if(genset_read_modbus_variables(genset_node_read)){
-					if(++genset_node_read >= genset_max_nodes) genset_node_read= 0;
-					//Read next pv inverter
-					scheduler= scheduler_read_pv;
+
+		//GENSET BUS - actual node modbus variables transactions was finished
+		PROF_BEGIN(prof_genset_bus);
+		if(genset_read_modbus_variables(genset_node_read)){
+			if(++genset_node_read >= genset_max_nodes) genset_node_read= 0;
+		}
+		PROF_END(prof_genset_bus);
+		//Bus alive - not waiting beyond the answer timeout
+		if(genset_node.getTransactionStatus() != transaction_receveing)
+			failsafe_heartbeat(failsafe_task_genset_bus);
+
+		//Reverse power protection - new trip conditions from genset samples and inputs
+		PROF_BEGIN(prof_protection);
+		manage_protection();
+		PROF_END(prof_protection);
+
+		//PV BUS - classes waiting for the bus
+		PROF_BEGIN(prof_pv_bus);
+		if(protection_pending())
+			pv_node.requestClass(pv_class_protection);
+		if(pv_setpoint_pending())
+			pv_node.requestClass(pv_class_setpoint);
+		else
+			pv_node.releaseClass(pv_class_setpoint);
+		pv_node.requestClass(pv_class_fast_read);
+		pv_node.requestClass(pv_class_slow_read);
+
+		//Highest class waiting takes the bus on the next transaction boundary
+		switch(pv_node.grantClass()){
+			case pv_class_protection:
+				//Protection setpoints join the pending writes - latency taken on the
+				//first grant only, the class stays granted until the frame ends
+				if(protection_pending())
+					protection_commanded();
+				//Nothing to write (no connected node) - leave the bus to the others
+				if(pv_write_modbus_setpoints())
+					pv_node.releaseClass(pv_class_protection);
+				break;
+			case pv_class_setpoint:
+				pv_write_modbus_setpoints();
+				break;
+			case pv_class_fast_read:{
+				uint8_t result= pv_read_active_power(pv_node_fast);
+				//Actual node transaction was finished (with success or not)
+				if((result == transaction_idle) || (result == transaction_timeout)){
+					if(++pv_node_fast >= pv_max_nodes) pv_node_fast= 0;
 				}
 				break;
-			case scheduler_read_pv:
-				//Actual node modbus variables transactions was finished
-				if(pv_read_modbus_variables(pv_node_read)){
-					if(++pv_node_read >= pv_max_nodes) pv_node_read= 0;
-					//Read next genset controller
-					scheduler= scheduler_read_genset;
+			}
+			case pv_class_slow_read:{
+				uint8_t result= pv_read_nominal_power(pv_node_slow);
+				if((result == transaction_idle) || (result == transaction_timeout)){
+					if(++pv_node_slow >= pv_max_nodes) pv_node_slow= 0;
 				}
 				break;
+			}
+		}
+		PROF_END(prof_pv_bus);
+		if(pv_node.getTransactionStatus() != transaction_receveing)
+			failsafe_heartbeat(failsafe_task_pv_bus);
+
+		//Digital inputs - whole port sampled and debounced each di_sample_period
+		PROF_BEGIN(prof_digital_inputs);
+		static uint8_t di_sample_time= 0;
+		if(++di_sample_time >= di_sample_period){
+			di_sample_time= 0;
+			di_sample_inputs();
+		}
+
+		//Keyboard - keys scanned and debounced each key_scan_period, events queued
+		static uint8_t key_scan_time= 0;
+		if(++key_scan_time >= key_scan_period){
+			key_scan_time= 0;
+			PROF_BEGIN(prof_keyboard);
+			keyboard_scan();
+			PROF_END(prof_keyboard);
 		}
 
 		//Manage digital inputs status
@@ -97,10 +157,76 @@ void loop() {
 		if(digital_inputs_sync_flag){
 			manage_digital_inputs();
 		}
+		PROF_END(prof_digital_inputs);
+
+		//Analogue inputs - DMA buffers decimated, engineering values each ai_publish_period
+		PROF_BEGIN(prof_analog_inputs);
+		manage_analog_inputs();
+		PROF_END(prof_analog_inputs);
+
+		//Circuit breakers status - transitions from genset controllers and inputs
+		PROF_BEGIN(prof_breakers);
+		manage_breakers();
+		PROF_END(prof_breakers);
+		//Grid tied or island - new strategy on the same tick of the transition
+		PROF_BEGIN(prof_operating_mode);
+		manage_operating_mode();
+		PROF_END(prof_operating_mode);
+
+		//Digital outputs - shadow applied to the ports, pulses and minimum on/off times
+		PROF_BEGIN(prof_digital_outputs);
+		manage_digital_outputs();
+		PROF_END(prof_digital_outputs);
+
+		//Display - changed cells sent to the panel, a few bytes per tick
+		PROF_BEGIN(prof_display);
+		manage_display();
+		PROF_END(prof_display);
+
+		//Failsafe - safe PV limit on stale genset data, watchdog feed
+		failsafe_heartbeat(failsafe_task_tick);
+		PROF_BEGIN(prof_failsafe);
+		manage_failsafe();
+		PROF_END(prof_failsafe);
+
+		//Profiler - debug port commands, one zone dumped each prof_period
+		static uint8_t prof_time= 0;
+		if(++prof_time >= prof_period){
+			prof_time= 0;
+			manage_profiler();
+		}
+	}
+
+//------------------ CONTROL TASK - FIXED RATE ---------------------
+	if ((unsigned long)(currentMillis - prev_millis_control) >= curtailment_period) {
+		prev_millis_control+= curtailment_period;
+		PROF_BEGIN(prof_control);
+
+		//Control uses the last values read
+		if(genset_flag_sync & (genset_sync_active_power | genset_sync_nominal_power)){
+			manage_genset_system();
+		}
+		if(pv_flag_sync & (pv_sync_active_power | pv_sync_nominal_power)){
+			manage_pv_system();
+		}
+
+		//PV limit of the operating mode - island: gensets above the minimum load,
+		//grid tied: export limit
+		//Suspended while the reverse power protection or the failsafe holds the PV limit
+		if(!protection_tripped && !failsafe_active()){
+			manage_mode_control();
+		}
+		failsafe_heartbeat(failsafe_task_control);
+		PROF_END(prof_control);
 	}
 
 //------------------ RESOURCE MANAGEMENT 10ms ---------------------
 	if (time_ms == 10) {
+		PROF_BEGIN(prof_systems);
+		//Totals with values older than the maximum age must be recalculated
+		genset_check_stale_values();
+		pv_check_stale_values();
+
 		//GENSETS NEW MODBUS VALUES
 		if(genset_flag_sync){
 			Serial.println("manage_genset_system()");
@@ -112,16 +238,15 @@ void loop() {
 			Serial.println("manage_pv_system()");
 			manage_pv_system();
 		}
+		PROF_END(prof_systems);
 }
 
 //------------------ RESOURCE MANAGEMENT 100ms ---------------------
 	else if (time_ms == 100) {
-		//KEYBOARD
-		if(keyboard_flag_sync){
-			Serial.println("manage_keyboard()");
-			manage_keyboard();
-		}
-
+		//OPERATOR MENU (keys and screen values)
+		PROF_BEGIN(prof_menu);
+		manage_menu();
+		PROF_END(prof_menu);
 	}
 
 //------------------ RESOURCE MANAGEMENT 200ms ---------------------
@@ -134,6 +259,8 @@ void loop() {
 		//Reset milliseconds to restart scheduler
 		time_ms= 0x0000;
 
+		PROF_BEGIN(prof_debug);
+
 		//LED run indication
 		digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
 
@@ -142,6 +269,11 @@ void loop() {
 		main_loop_time_average_sum= 0;
 		main_loop_iteraction_count= 0;
 		Serial.println(main_loop_time_average);
+
+		//Sequence of events - debug dump of the oldest events
+		soe_dump();
+		PROF_END(prof_debug);
 	}
 
+	PROF_END(prof_loop);
 }
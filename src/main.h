@@ -14,5 +14,14 @@
 #include "genset_modbus.h"
 #include "keyboard.h"
 #include "digital_inputs.h"
+#include "breakers.h"
+#include "dispatcher.h"
+#include "curtailment.h"
+#include "protection.h"
+#include "operating_mode.h"
+#include "failsafe.h"
+#include "sequence_of_events.h"
+#include "menu.h"
+#include "profiler.h"
 
 #endif /* MAIN_H_ */
@@ -0,0 +1,524 @@
+/*
+ * menu.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Operator menu - screens and fields declared on const tables (flash),
+ *      keypad navigation and editors, rendered on the display frame buffer
+ */
+
+#ifndef MENU_H_
+#define MENU_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include "keyboard.h"
+#include "display.h"
+#include "pv_modbus.h"
+#include "genset_modbus.h"
+#include "curtailment.h"
+#include "operating_mode.h"
+#include "analog_inputs.h"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Value bound to a field - @instance is the node of the screen (0 if not per node)
+typedef int32_t (*menu_getter)(uint8_t instance);
+//Value edited - applied on ENTER
+typedef void (*menu_setter)(uint8_t instance, int32_t value);
+
+//Field of a screen - label and value at row, col
+typedef struct{
+	const char *label;
+	uint8_t row;
+	uint8_t col;
+	uint8_t width;				//Value characters
+	uint8_t decimals;			//Value digits after the decimal point
+	const char * const *texts;	//Text of each value (NULL= number)
+	menu_getter get;
+	menu_setter set;			//NULL= read only
+	int32_t min;				//Editor range and step
+	int32_t max;
+	int32_t step;
+}_menu_field;
+
+//Screen - fields shown once or per node (@instances)
+typedef struct{
+	const char *title;
+	const _menu_field *fields;
+	uint8_t fields_nr;
+	uint8_t instances;			//Nodes - UP/DOWN select the node
+	uint8_t parent;				//Screen on ESC (itself on the root)
+}_menu_screen;
+
+//Texts of the enumerations shown
+const char * const menu_comm_texts[]= {"OFF", "ON", "T/O"};				//comm_status
+const char * const menu_inverter_texts[]= {"----", "SUNG", "ABB", "FRON"};	//inverters
+const char * const menu_genset_texts[]= {"----", "SICE"};					//genset_controllers
+const char * const menu_mode_texts[]= {"NONE", "ISLD", "GRID"};			//operating_mode
+
+//Value bindings (getters and setters) - defined with the functions
+int32_t menu_pv_total(uint8_t instance);
+int32_t menu_genset_total(uint8_t instance);
+int32_t menu_load_total(uint8_t instance);
+int32_t menu_pv_limit(uint8_t instance);
+int32_t menu_mode(uint8_t instance);
+int32_t menu_frequency(uint8_t instance);
+int32_t menu_pv_active(uint8_t instance);
+int32_t menu_pv_nominal(uint8_t instance);
+int32_t menu_pv_ack(uint8_t instance);
+int32_t menu_pv_comm(uint8_t instance);
+int32_t menu_pv_addr(uint8_t instance);
+int32_t menu_pv_type(uint8_t instance);
+void menu_set_pv_addr(uint8_t instance, int32_t value);
+void menu_set_pv_type(uint8_t instance, int32_t value);
+int32_t menu_genset_active(uint8_t instance);
+int32_t menu_genset_nominal(uint8_t instance);
+int32_t menu_genset_comm(uint8_t instance);
+int32_t menu_genset_addr(uint8_t instance);
+int32_t menu_genset_type(uint8_t instance);
+void menu_set_genset_addr(uint8_t instance, int32_t value);
+void menu_set_genset_type(uint8_t instance, int32_t value);
+int32_t menu_export_limit(uint8_t instance);
+int32_t menu_min_load(uint8_t instance);
+void menu_set_export_limit(uint8_t instance, int32_t value);
+void menu_set_min_load(uint8_t instance, int32_t value);
+
+/**
+ * Screens - 20x4 display, title on row 0
+ * Powers in 0.1kW, limits in 0.1%
+ */
+const _menu_field menu_plant_fields[]= {
+	//label	row col width dec texts					get					set						min max step
+	{"PV",		1, 0,	7, 1, NULL,					menu_pv_total,		NULL,					0, 0, 0},
+	{"Lim",		1, 11,	6, 1, NULL,					menu_pv_limit,		NULL,					0, 0, 0},
+	{"Gen",		2, 0,	6, 1, NULL,					menu_genset_total,	NULL,					0, 0, 0},
+	{"Mode ",	2, 11,	4, 0, menu_mode_texts,		menu_mode,			NULL,					0, 0, 0},
+	{"Load",	3, 0,	6, 1, NULL,					menu_load_total,	NULL,					0, 0, 0},
+	{"Hz",		3, 11,	6, 2, NULL,					menu_frequency,		NULL,					0, 0, 0},
+};
+
+const _menu_field menu_pv_fields[]= {
+	{"P",		1, 0,	7, 1, NULL,					menu_pv_active,		NULL,					0, 0, 0},
+	{"Lim",		1, 11,	6, 1, NULL,					menu_pv_ack,		NULL,					0, 0, 0},
+	{"Comm ",	2, 0,	4, 0, menu_comm_texts,		menu_pv_comm,		NULL,					0, 0, 0},
+	{"Pn",		2, 11,	7, 1, NULL,					menu_pv_nominal,	NULL,					0, 0, 0},
+	{"Addr",	3, 0,	4, 0, NULL,					menu_pv_addr,		menu_set_pv_addr,		1, 247, 1},
+	{"Type ",	3, 11,	4, 0, menu_inverter_texts,	menu_pv_type,		menu_set_pv_type,		NoInverter, Fronius, 1},
+};
+
+const _menu_field menu_genset_fields[]= {
+	{"P",		1, 0,	7, 1, NULL,					menu_genset_active,	NULL,					0, 0, 0},
+	{"Comm ",	2, 0,	4, 0, menu_comm_texts,		menu_genset_comm,	NULL,					0, 0, 0},
+	{"Pn",		2, 11,	7, 1, NULL,					menu_genset_nominal, NULL,					0, 0, 0},
+	{"Addr",	3, 0,	4, 0, NULL,					menu_genset_addr,	menu_set_genset_addr,	1, 247, 1},
+	{"Type ",	3, 11,	4, 0, menu_genset_texts,	menu_genset_type,	menu_set_genset_type,	NoGenset, Sices, 1},
+};
+
+const _menu_field menu_setup_fields[]= {
+	{"Export lim %",	1, 0, 6, 1, NULL,			menu_export_limit,	menu_set_export_limit,	0, 1000, 5},
+	{"Gen min load %",	2, 0, 5, 1, NULL,			menu_min_load,		menu_set_min_load,		0, 1000, 5},
+};
+
+//Screens indexes
+static const uint8_t menu_screen_plant= 0;
+static const uint8_t menu_screen_pv= 1;
+static const uint8_t menu_screen_genset= 2;
+static const uint8_t menu_screen_setup= 3;
+
+#define menu_fields_nr(fields) (sizeof(fields) / sizeof(fields[0]))
+
+const _menu_screen menu_screens[]= {
+	//title			fields				fields_nr							instances			parent
+	{"PLANT",		menu_plant_fields,	menu_fields_nr(menu_plant_fields),	1,					menu_screen_plant},
+	{"PV NODE",		menu_pv_fields,		menu_fields_nr(menu_pv_fields),		pv_max_nodes,		menu_screen_plant},
+	{"GENSET",		menu_genset_fields,	menu_fields_nr(menu_genset_fields),	genset_max_nodes,	menu_screen_plant},
+	{"SETUP",		menu_setup_fields,	menu_fields_nr(menu_setup_fields),	1,					menu_screen_plant},
+};
+static const uint8_t menu_screens_nr= sizeof(menu_screens) / sizeof(menu_screens[0]);
+
+//No field selected
+static const uint8_t menu_field_none= 0xFF;
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+//Menu state - same RAM for any screen
+uint8_t menu_screen;		//Actual screen
+uint8_t menu_instance;		//Node of the screen
+uint8_t menu_field;			//Field being edited (menu_field_none: view)
+int32_t menu_edit_value;	//Value being edited
+
+//Signature of the last rendered frame - new render only on changes
+uint32_t menu_signature;
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the menu on the plant screen
+ * ----------------------------------------------------------------*/
+void menu_init();
+
+/*------------------------------------------------------------------
+ * Next (@direction= 1) or previous (-1) screen with the same parent
+ * ----------------------------------------------------------------*/
+uint8_t menu_sibling(uint8_t screen, int8_t direction);
+
+/*------------------------------------------------------------------
+ * First screen child of @screen (@screen if none)
+ * ----------------------------------------------------------------*/
+uint8_t menu_child(uint8_t screen);
+
+/*------------------------------------------------------------------
+ * Next (@direction= 1) or previous (-1) editable field from @field
+ * Return menu_field_none if the screen has no editable field
+ * ----------------------------------------------------------------*/
+uint8_t menu_editable_field(uint8_t field, int8_t direction);
+
+/*------------------------------------------------------------------
+ * Handle a key event
+ * ----------------------------------------------------------------*/
+void menu_key(const _key_event *event);
+
+/*------------------------------------------------------------------
+ * Render the actual screen on the display frame buffer
+ * ----------------------------------------------------------------*/
+void menu_render();
+
+/*------------------------------------------------------------------
+ * Key events and screen update - called from main loop each 100ms
+ * ----------------------------------------------------------------*/
+void manage_menu();
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Value bindings - plant
+ * ----------------------------------------------------------------*/
+int32_t menu_pv_total(uint8_t instance){
+	return(pv_active_power_total / 100);
+}
+
+int32_t menu_genset_total(uint8_t instance){
+	return(genset_active_power_total / 100);
+}
+
+int32_t menu_load_total(uint8_t instance){
+	return((pv_active_power_total + genset_active_power_total) / 100);
+}
+
+int32_t menu_pv_limit(uint8_t instance){
+	return(curtailment_pv_limit_percent);
+}
+
+int32_t menu_mode(uint8_t instance){
+	return(operating_mode);
+}
+
+int32_t menu_frequency(uint8_t instance){
+	return(ai_ac.valid ? (int32_t)(ai_ac.frequency / 10) : 0);
+}
+
+/*------------------------------------------------------------------
+ * Value bindings - PV nodes
+ * ----------------------------------------------------------------*/
+int32_t menu_pv_active(uint8_t instance){
+	return(pv_active_power_to_w(instance, pv_nodes[instance].node_modbus_variables.active_power) / 100);
+}
+
+int32_t menu_pv_nominal(uint8_t instance){
+	return(pv_nominal_power_to_w(instance, pv_nodes[instance].node_modbus_variables.nominal_power) / 100);
+}
+
+int32_t menu_pv_ack(uint8_t instance){
+	uint16_t acknowledged= pv_nodes[instance].power_limit_acknowledged;
+
+	//Unknown - does not fit, shown as '*'
+	return((acknowledged == pv_power_limit_unknown) ? INT32_MAX : acknowledged);
+}
+
+int32_t menu_pv_comm(uint8_t instance){
+	return(pv_nodes[instance].node_communication_status);
+}
+
+int32_t menu_pv_addr(uint8_t instance){
+	return(pv_nodes[instance].node_addr);
+}
+
+int32_t menu_pv_type(uint8_t instance){
+	return(pv_nodes[instance].node_type);
+}
+
+void menu_set_pv_addr(uint8_t instance, int32_t value){
+	pv_set_node_addr(instance, (uint8_t)value);
+}
+
+void menu_set_pv_type(uint8_t instance, int32_t value){
+	pv_set_node_type(instance, (inverters)value);
+}
+
+/*------------------------------------------------------------------
+ * Value bindings - genset nodes
+ * ----------------------------------------------------------------*/
+int32_t menu_genset_active(uint8_t instance){
+	return(genset_active_power_to_w(instance, genset_nodes[instance].node_modbus_variables.active_power) / 100);
+}
+
+int32_t menu_genset_nominal(uint8_t instance){
+	return(genset_nominal_power_to_w(instance, genset_nodes[instance].node_modbus_variables.nominal_power) / 100);
+}
+
+int32_t menu_genset_comm(uint8_t instance){
+	return(genset_nodes[instance].node_communication_status);
+}
+
+int32_t menu_genset_addr(uint8_t instance){
+	return(genset_nodes[instance].node_addr);
+}
+
+int32_t menu_genset_type(uint8_t instance){
+	return(genset_nodes[instance].node_type);
+}
+
+void menu_set_genset_addr(uint8_t instance, int32_t value){
+	genset_set_node_addr(instance, (uint8_t)value);
+}
+
+void menu_set_genset_type(uint8_t instance, int32_t value){
+	genset_set_node_type(instance, (genset_controllers)value);
+}
+
+/*------------------------------------------------------------------
+ * Value bindings - setup
+ * ----------------------------------------------------------------*/
+int32_t menu_export_limit(uint8_t instance){
+	return(mode_export_limit);
+}
+
+int32_t menu_min_load(uint8_t instance){
+	return(curtailment_min_load);
+}
+
+void menu_set_export_limit(uint8_t instance, int32_t value){
+	mode_set_export_limit((uint16_t)value);
+}
+
+void menu_set_min_load(uint8_t instance, int32_t value){
+	curtailment_set_min_load((uint16_t)value);
+}
+
+/*------------------------------------------------------------------
+ * Initialize the menu on the plant screen
+ * ----------------------------------------------------------------*/
+void menu_init(){
+	menu_screen= menu_screen_plant;
+	menu_instance= 0;
+	menu_field= menu_field_none;
+	menu_edit_value= 0;
+	menu_signature= 0;
+
+	menu_render();
+}
+
+/*------------------------------------------------------------------
+ * Next (@direction= 1) or previous (-1) screen with the same parent
+ * ----------------------------------------------------------------*/
+uint8_t menu_sibling(uint8_t screen, int8_t direction){
+	uint8_t parent= menu_screens[screen].parent;
+	uint8_t next= screen;
+
+	//Root has no siblings
+	if(parent == screen)
+		return(screen);
+
+	do{
+		next= (next + menu_screens_nr + direction) % menu_screens_nr;
+	}while((next != screen) && ((menu_screens[next].parent != parent) || (next == parent)));
+
+	return(next);
+}
+
+/*------------------------------------------------------------------
+ * First screen child of @screen (@screen if none)
+ * ----------------------------------------------------------------*/
+uint8_t menu_child(uint8_t screen){
+	for(uint8_t i= 0; i < menu_screens_nr; i++){
+		if((i != screen) && (menu_screens[i].parent == screen))
+			return(i);
+	}
+
+	return(screen);
+}
+
+/*------------------------------------------------------------------
+ * Next (@direction= 1) or previous (-1) editable field from @field
+ * Return menu_field_none if the screen has no editable field
+ * ----------------------------------------------------------------*/
+uint8_t menu_editable_field(uint8_t field, int8_t direction){
+	const _menu_screen *screen= &menu_screens[menu_screen];
+
+	for(uint8_t i= 0; i < screen->fields_nr; i++){
+		field= (field + screen->fields_nr + direction) % screen->fields_nr;
+		if(screen->fields[field].set != NULL)
+			return(field);
+	}
+
+	return(menu_field_none);
+}
+
+/*------------------------------------------------------------------
+ * Handle a key event
+ * View: LEFT/RIGHT screen, UP/DOWN node, ENTER sub screens or edit,
+ * ESC parent screen (long press: plant screen)
+ * Edit: LEFT/RIGHT field, UP/DOWN value, ENTER apply, ESC cancel
+ * ----------------------------------------------------------------*/
+void menu_key(const _key_event *event){
+	const _menu_screen *screen= &menu_screens[menu_screen];
+	uint8_t mask= (1 << event->key);
+
+	//Releases are not used
+	if(event->type == key_event_release)
+		return;
+
+	//Edit
+	if(menu_field != menu_field_none){
+		const _menu_field *field= &screen->fields[menu_field];
+
+		switch(mask){
+			case left_button_mask:
+			case right_button_mask:
+				menu_field= menu_editable_field(menu_field, (mask == right_button_mask) ? 1 : -1);
+				menu_edit_value= screen->fields[menu_field].get(menu_instance);
+				break;
+			case up_button_mask:
+				menu_edit_value+= field->step;
+				if(menu_edit_value > field->max)
+					menu_edit_value= field->max;
+				break;
+			case down_button_mask:
+				menu_edit_value-= field->step;
+				if(menu_edit_value < field->min)
+					menu_edit_value= field->min;
+				break;
+			case enter_button_mask:
+				if(event->type == key_event_press){
+					field->set(menu_instance, menu_edit_value);
+					menu_field= menu_field_none;
+				}
+				break;
+			case esc_button_mask:
+				menu_field= menu_field_none;
+				break;
+		}
+		return;
+	}
+
+	//View
+	switch(mask){
+		case left_button_mask:
+		case right_button_mask:
+			menu_screen= menu_sibling(menu_screen, (mask == right_button_mask) ? 1 : -1);
+			menu_instance= 0;
+			break;
+		case up_button_mask:
+			if(++menu_instance >= screen->instances)
+				menu_instance= 0;
+			break;
+		case down_button_mask:
+			menu_instance= (menu_instance == 0) ? screen->instances - 1 : menu_instance - 1;
+			break;
+		case enter_button_mask:{
+			if(event->type != key_event_press)
+				break;
+
+			uint8_t child= menu_child(menu_screen);
+			if(child != menu_screen){
+				menu_screen= child;
+				menu_instance= 0;
+				break;
+			}
+
+			//Last field before the first one - the first editable is selected
+			menu_field= menu_editable_field(screen->fields_nr - 1, 1);
+			if(menu_field != menu_field_none)
+				menu_edit_value= screen->fields[menu_field].get(menu_instance);
+			break;
+		}
+		case esc_button_mask:
+			menu_screen= (event->type == key_event_long_press) ? menu_screen_plant : screen->parent;
+			menu_instance= 0;
+			break;
+	}
+}
+
+/*------------------------------------------------------------------
+ * Render the actual screen on the display frame buffer
+ * The field edited shows the edit value and '>' on its label
+ * ----------------------------------------------------------------*/
+void menu_render(){
+	const _menu_screen *screen= &menu_screens[menu_screen];
+
+	display_clear();
+
+	//Title - node number on screens per node
+	display_print(0, 0, screen->title);
+	if(screen->instances > 1)
+		display_print_number(0, display_cols - 5, menu_instance + 1, 5, 0);
+	if(menu_field != menu_field_none)
+		display_print(0, 10, "EDIT");
+
+	for(uint8_t i= 0; i < screen->fields_nr; i++){
+		const _menu_field *field= &screen->fields[i];
+		int32_t value= (i == menu_field) ? menu_edit_value : field->get(menu_instance);
+		uint8_t col= field->col + strlen(field->label);
+
+		display_print(field->row, field->col, field->label);
+		if(i == menu_field)
+			display_print(field->row, field->col, ">");
+
+		if(field->texts != NULL)
+			display_print(field->row, col, field->texts[value]);
+		else
+			display_print_number(field->row, col, value, field->width, field->decimals);
+	}
+}
+
+/*------------------------------------------------------------------
+ * Key events and screen update - called from main loop each 100ms
+ * The screen is rendered again only if the state or some bound value
+ * changed (signature of the values - no copy of the screen in RAM)
+ * ----------------------------------------------------------------*/
+void manage_menu(){
+	_key_event event;
+
+	keyboard_flag_sync= no_key_pressed; //Reset flag
+	while(key_event_get(&event))
+		menu_key(&event);
+
+	//Signature of the state and the values shown
+	const _menu_screen *screen= &menu_screens[menu_screen];
+	uint32_t signature= 2166136261UL; //FNV-1a
+	uint32_t state[]= {menu_screen, menu_instance, menu_field, (uint32_t)menu_edit_value};
+	for(uint8_t i= 0; i < sizeof(state) / sizeof(state[0]); i++)
+		signature= (signature ^ state[i]) * 16777619UL;
+	for(uint8_t i= 0; i < screen->fields_nr; i++)
+		signature= (signature ^ (uint32_t)screen->fields[i].get(menu_instance)) * 16777619UL;
+
+	if(signature == menu_signature)
+		return;
+
+	menu_signature= signature;
+	menu_render();
+}
+
+
+#endif /* MENU_H_ */
@@ -0,0 +1,278 @@
+/*
+ * operating_mode.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Operating mode - grid tied or island control strategy
+ */
+
+#ifndef OPERATING_MODE_H_
+#define OPERATING_MODE_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include "pv_modbus.h"
+#include "genset_modbus.h"
+#include "breakers.h"
+#include "digital_inputs_functions.h"
+#include "pi_controller.h"
+#include "dispatcher.h"
+#include "curtailment.h"
+#include "protection.h"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Operating modes
+static const uint8_t mode_no_source= 0x00;	//Mains and gensets off the bus - PV held at zero
+static const uint8_t mode_island= 0x01;		//MCB opened - gensets above the minimum load
+static const uint8_t mode_grid_tied= 0x02;	//MCB closed - export limit
+
+//Default export limit while grid tied [0.1% of pv_nominal_power_total]
+//No meter on the mains - the export limit caps the PV power
+static const uint16_t mode_export_limit_default= 1000; //100.0% - no limitation
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+//Configuration
+uint16_t mode_export_limit;	//PV limit while grid tied [0.1% of pv_nominal_power_total]
+
+//Actual operating mode
+uint8_t operating_mode;
+
+//Mode transitions - breaker (or genset communication) change to new PV limit dispatched
+typedef struct{
+	uint16_t transitions;	//Number of transitions
+	uint8_t from;			//Last transition
+	uint8_t to;
+	int32_t pv_limit;		//PV limit pre-computed on the last transition [W]
+	uint32_t latency_last;	//Detection to PV limit dispatched [us]
+	uint32_t latency_max;
+}_mode_transition_log;
+
+_mode_transition_log mode_transition_log;
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the operating mode manager
+ * ----------------------------------------------------------------*/
+void mode_init();
+
+/*------------------------------------------------------------------
+ * Set the export limit while grid tied [0.1% of pv_nominal_power_total]
+ * ----------------------------------------------------------------*/
+void mode_set_export_limit(uint16_t export_limit);
+
+/*------------------------------------------------------------------
+ * Operating mode from the breakers status and genset communication
+ * ----------------------------------------------------------------*/
+uint8_t mode_select();
+
+/*------------------------------------------------------------------
+ * PV limit [W] of @mode computed from the last values read
+ * ----------------------------------------------------------------*/
+int32_t mode_pv_limit(uint8_t mode);
+
+/*------------------------------------------------------------------
+ * Pass to @mode - the PV limit of the new strategy is dispatched at once
+ * @detection_time is the time [us] the change was detected
+ * ----------------------------------------------------------------*/
+void mode_transition(uint8_t mode, uint32_t detection_time);
+
+/*------------------------------------------------------------------
+ * Check the mode transitions - called from main loop each 1ms
+ * ----------------------------------------------------------------*/
+void manage_operating_mode();
+
+/*------------------------------------------------------------------
+ * Control task of the actual mode - called from main loop each
+ * curtailment_period
+ * ----------------------------------------------------------------*/
+void manage_mode_control();
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the operating mode manager
+ * ----------------------------------------------------------------*/
+void mode_init(){
+	mode_export_limit= mode_export_limit_default;
+
+	//No source until some genset answers or the mains breaker is closed
+	operating_mode= mode_no_source;
+
+	mode_transition_log.transitions= 0;
+	mode_transition_log.from= mode_no_source;
+	mode_transition_log.to= mode_no_source;
+	mode_transition_log.pv_limit= 0;
+	mode_transition_log.latency_last= 0;
+	mode_transition_log.latency_max= 0;
+}
+
+/*------------------------------------------------------------------
+ * Set the export limit while grid tied [0.1% of pv_nominal_power_total]
+ * ----------------------------------------------------------------*/
+void mode_set_export_limit(uint16_t export_limit){
+	if(export_limit > pv_power_limit_max)
+		export_limit= pv_power_limit_max;
+
+	mode_export_limit= export_limit;
+}
+
+/*------------------------------------------------------------------
+ * Operating mode from the breakers status and genset communication
+ * Breakers without valid status do not change the mode
+ * ----------------------------------------------------------------*/
+uint8_t mode_select(){
+	//Mains on the bus
+	if(breakers[breaker_mcb].valid && (di_functions.dif_mcb_status == circuit_breaker_closed))
+		return(mode_grid_tied);
+
+	//Gensets on the bus - some controller answering and GCB closed
+	bool genset_connected= false;
+	for(uint8_t i= 0; i < genset_max_nodes; i++){
+		if((genset_nodes[i].node_type != NoGenset) &&
+		   (genset_nodes[i].node_communication_status != disconnected)){
+			genset_connected= true;
+			break;
+		}
+	}
+	if(genset_connected &&
+	   (!breakers[breaker_gcb].valid || (di_functions.dif_gcb_status == circuit_breaker_closed)))
+		return(mode_island);
+
+	return(mode_no_source);
+}
+
+/*------------------------------------------------------------------
+ * PV limit [W] of @mode computed from the last values read
+ * ----------------------------------------------------------------*/
+int32_t mode_pv_limit(uint8_t mode){
+	int32_t limit= 0;
+
+	switch(mode){
+		case mode_island:{
+			//Load supplied now by PV and gensets (mains contribution is lost,
+			//so the gensets only get more load) minus the gensets minimum load
+			int32_t genset_min_load= (int32_t)(((int64_t)genset_nominal_power_total * curtailment_min_load) / 1000);
+			limit= pv_active_power_total + genset_active_power_total - genset_min_load;
+			break;
+		}
+		case mode_grid_tied:
+			limit= (int32_t)(((int64_t)pv_nominal_power_total * mode_export_limit) / 1000);
+			break;
+		default:
+			limit= 0;
+			break;
+	}
+
+	if(limit > pv_nominal_power_total)
+		limit= pv_nominal_power_total;
+	if(limit < 0)
+		limit= 0;
+
+	return(limit);
+}
+
+/*------------------------------------------------------------------
+ * Pass to @mode - the PV limit of the new strategy is dispatched at once
+ * @detection_time is the time [us] the change was detected
+ * ----------------------------------------------------------------*/
+void mode_transition(uint8_t mode, uint32_t detection_time){
+	int32_t limit= mode_pv_limit(mode);
+
+	mode_transition_log.from= operating_mode;
+	mode_transition_log.to= mode;
+	mode_transition_log.pv_limit= limit;
+	mode_transition_log.transitions++;
+	operating_mode= mode;
+
+	//New strategy starts from the pre-computed limit - no control gap
+	curtailment_pv_limit= limit;
+	if(pv_nominal_power_total > 0)
+		curtailment_pv_limit_percent= (uint16_t)(((int64_t)limit * pv_power_limit_max) / pv_nominal_power_total);
+	pi_reset(&curtailment_pi, limit);
+	ramp_reset(&curtailment_ramp, limit);
+	curtailment_prev_pv_active= pv_active_power_total;
+	//Island without values to control - bumpless start from the actual PV power
+	curtailment_running= (mode == mode_island) &&
+						 (genset_active_power_status.contributors > 0) && (pv_nominal_power_total > 0);
+
+	//Protection holds the PV limit until the release
+	if(!protection_tripped && (pv_nominal_power_total > 0))
+		dispatch_pv_limit(limit, genset_active_power_status.newest_time);
+
+	mode_transition_log.latency_last= micros() - detection_time;
+	if(mode_transition_log.latency_last > mode_transition_log.latency_max)
+		mode_transition_log.latency_max= mode_transition_log.latency_last;
+}
+
+/*------------------------------------------------------------------
+ * Check the mode transitions - called from main loop each 1ms
+ * ----------------------------------------------------------------*/
+void manage_operating_mode(){
+	uint8_t mode= mode_select();
+
+	//Breaker events are handled here - the mode is checked on each tick
+	//anyway (genset communication changes do not raise events)
+	uint8_t events= breaker_events;
+	breaker_events= 0;
+
+	if(mode == operating_mode)
+		return;
+
+	//Detection time - newest breaker transition, now if not caused by a breaker
+	uint32_t detection_time= micros();
+	for(uint8_t i= 0; i < breakers_nr; i++){
+		if((events & (1 << i)) && ((int32_t)(breakers[i].change_time - detection_time) < 0))
+			detection_time= breakers[i].change_time;
+	}
+
+	mode_transition(mode, detection_time);
+}
+
+/*------------------------------------------------------------------
+ * Control task of the actual mode - called from main loop each
+ * curtailment_period
+ * ----------------------------------------------------------------*/
+void manage_mode_control(){
+	switch(operating_mode){
+		case mode_island:
+			//Gensets above the minimum load
+			manage_curtailment();
+			break;
+
+		case mode_grid_tied:{
+			if(pv_nominal_power_total <= 0)
+				break;
+
+			uint16_t limit_percent= mode_export_limit;
+			//Power limitation disabled by digital input
+			if(curtailment_limit_input())
+				limit_percent= pv_power_limit_max;
+
+			//Export limit reached through the ramp rate limiter
+			curtailment_pv_limit= curtailment_ramp_limit((int32_t)(((int64_t)pv_nominal_power_total * limit_percent) / 1000), true);
+			curtailment_pv_limit_percent= (uint16_t)(((int64_t)curtailment_pv_limit * pv_power_limit_max) / pv_nominal_power_total);
+			dispatch_pv_limit(curtailment_pv_limit, millis());
+			break;
+		}
+
+		default:
+			//No source - PV held at the limit set on the transition
+			break;
+	}
+}
+
+
+#endif /* OPERATING_MODE_H_ */
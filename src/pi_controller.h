@@ -0,0 +1,190 @@
+/*
+ * pi_controller.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Discrete PI controller - integer arithmetic only (no FPU)
+ *      No Arduino dependency, can be compiled on the host for tuning
+ */
+
+#ifndef PI_CONTROLLER_H_
+#define PI_CONTROLLER_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include <stdint.h>
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+/**
+ * Gains are fixed point Q16: 65536 = 1.0
+ */
+static const uint8_t pi_q= 16;
+static const int32_t pi_one= ((int32_t)1 << pi_q);
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+typedef struct{
+	//Tuning
+	int32_t kp;				//Proportional gain [Q16]
+	int32_t ki;				//Integral gain per new measurement (Ki * T) [Q16]
+	int32_t kff;			//Feed-forward gain [Q16]
+
+	//Output limits
+	int32_t output_min;		//Minimum output
+	int32_t output_max;		//Maximum output
+	int32_t rate_max;		//Maximum output change per period (0= no limit)
+
+	//State
+	int64_t integral;		//Integral term [Q16]
+	int32_t output;			//Last output
+	bool saturated;			//Last output was limited (range or rate)
+}_pi_controller;
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the controller gains [Q16] and output limits
+ * ----------------------------------------------------------------*/
+void pi_init(_pi_controller *pi, int32_t kp, int32_t ki, int32_t kff,
+			 int32_t output_min, int32_t output_max, int32_t rate_max);
+
+/*------------------------------------------------------------------
+ * Set the output range - the integral is clamped to the new range
+ * ----------------------------------------------------------------*/
+void pi_set_limits(_pi_controller *pi, int32_t output_min, int32_t output_max);
+
+/*------------------------------------------------------------------
+ * Bumpless restart - next outputs start from @output
+ * ----------------------------------------------------------------*/
+void pi_reset(_pi_controller *pi, int32_t output);
+
+/*------------------------------------------------------------------
+ * Controller step - called once per period
+ * @error= setpoint - measurement (controller sign convention)
+ * @feed_forward is weighted by kff and added to the output
+ * @new_measurement= false holds the integral (measurement not updated
+ * since the last period)
+ * Return the new output
+ * ----------------------------------------------------------------*/
+int32_t pi_update(_pi_controller *pi, int32_t error, int32_t feed_forward, bool new_measurement);
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the controller gains [Q16] and output limits
+ * ----------------------------------------------------------------*/
+void pi_init(_pi_controller *pi, int32_t kp, int32_t ki, int32_t kff,
+			 int32_t output_min, int32_t output_max, int32_t rate_max){
+	pi->kp= kp;
+	pi->ki= ki;
+	pi->kff= kff;
+	pi->output_min= output_min;
+	pi->output_max= output_max;
+	pi->rate_max= rate_max;
+
+	pi_reset(pi, output_min);
+}
+
+/*------------------------------------------------------------------
+ * Set the output range - the integral is clamped to the new range
+ * ----------------------------------------------------------------*/
+void pi_set_limits(_pi_controller *pi, int32_t output_min, int32_t output_max){
+	pi->output_min= output_min;
+	pi->output_max= output_max;
+
+	if(pi->integral > ((int64_t)output_max << pi_q))
+		pi->integral= ((int64_t)output_max << pi_q);
+	if(pi->integral < ((int64_t)output_min << pi_q))
+		pi->integral= ((int64_t)output_min << pi_q);
+}
+
+/*------------------------------------------------------------------
+ * Bumpless restart - next outputs start from @output
+ * ----------------------------------------------------------------*/
+void pi_reset(_pi_controller *pi, int32_t output){
+	pi->integral= ((int64_t)output << pi_q);
+	pi->output= output;
+	pi->saturated= false;
+}
+
+/*------------------------------------------------------------------
+ * Controller step - called once per period
+ * @error= setpoint - measurement (controller sign convention)
+ * @feed_forward is weighted by kff and added to the output
+ * @new_measurement= false holds the integral (measurement not updated
+ * since the last period)
+ * Return the new output
+ * ----------------------------------------------------------------*/
+int32_t pi_update(_pi_controller *pi, int32_t error, int32_t feed_forward, bool new_measurement){
+	int64_t integral= pi->integral;
+	if(new_measurement)
+		integral+= (int64_t)pi->ki * error;
+
+	//Q16 sum of all terms, back to output units (rounded)
+	int64_t proportional= (int64_t)pi->kp * error;
+	int64_t feed_forward_term= (int64_t)pi->kff * feed_forward;
+	int64_t output= (proportional + integral + feed_forward_term + (pi_one / 2)) >> pi_q;
+
+	//Output window - range limits and rate limit
+	int32_t lower= pi->output_min;
+	int32_t upper= pi->output_max;
+	if(pi->rate_max > 0){
+		if((pi->output - pi->rate_max) > lower)
+			lower= pi->output - pi->rate_max;
+		if((pi->output + pi->rate_max) < upper)
+			upper= pi->output + pi->rate_max;
+	}
+
+	bool saturated_high= false;
+	bool saturated_low= false;
+	if(output > upper){
+		output= upper;
+		saturated_high= true;
+	}
+	else if(output < lower){
+		output= lower;
+		saturated_low= true;
+	}
+
+	//Clamping anti-windup - while the output is limited and the error
+	//drives further into the limit, the integral may only follow the
+	//limited output (rate limit), never go beyond it
+	int64_t tracking= ((int64_t)output << pi_q) - proportional - feed_forward_term;
+	if(saturated_high && (error > 0)){
+		if(integral > tracking)
+			integral= tracking;
+		if(integral < pi->integral)
+			integral= pi->integral;
+	}
+	else if(saturated_low && (error < 0)){
+		if(integral < tracking)
+			integral= tracking;
+		if(integral > pi->integral)
+			integral= pi->integral;
+	}
+
+	if(integral > ((int64_t)pi->output_max << pi_q))
+		integral= ((int64_t)pi->output_max << pi_q);
+	if(integral < ((int64_t)pi->output_min << pi_q))
+		integral= ((int64_t)pi->output_min << pi_q);
+	pi->integral= integral;
+
+	pi->saturated= saturated_high || saturated_low;
+	pi->output= (int32_t)output;
+
+	return(pi->output);
+}
+
+
+#endif /* PI_CONTROLLER_H_ */
@@ -0,0 +1,214 @@
+/*
+ * profiler.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Loop profiler - cycles of named zones counted by the Cortex-M3 DWT
+ *      cycle counter: count, min, max, average and log2 histogram per zone
+ *      Compiled only with PROFILER_ENABLED (hal/board.h), otherwise the
+ *      zone marks are empty
+ */
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include "hal/board.h"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Zones
+static const uint8_t prof_loop= 0;				//Whole loop iteration
+static const uint8_t prof_genset_bus= 1;		//Genset Modbus engine
+static const uint8_t prof_pv_bus= 2;			//PV Modbus engine and bus arbitration
+static const uint8_t prof_protection= 3;		//manage_protection
+static const uint8_t prof_digital_inputs= 4;	//Inputs sampling and manage_digital_inputs
+static const uint8_t prof_keyboard= 5;			//keyboard_scan
+static const uint8_t prof_analog_inputs= 6;		//manage_analog_inputs
+static const uint8_t prof_breakers= 7;			//manage_breakers
+static const uint8_t prof_operating_mode= 8;	//manage_operating_mode
+static const uint8_t prof_digital_outputs= 9;	//manage_digital_outputs
+static const uint8_t prof_display= 10;			//manage_display
+static const uint8_t prof_failsafe= 11;			//manage_failsafe
+static const uint8_t prof_control= 12;			//Control task
+static const uint8_t prof_systems= 13;			//Stale values and systems management (10ms)
+static const uint8_t prof_menu= 14;				//manage_menu
+static const uint8_t prof_debug= 15;			//Debug prints (500ms)
+static const uint8_t prof_zones_nr= 16;
+
+const char * const prof_zone_names[prof_zones_nr]= {
+	"loop", "genset_bus", "pv_bus", "protection", "digital_inputs", "keyboard",
+	"analog_inputs", "breakers", "operating_mode", "digital_outputs", "display",
+	"failsafe", "control", "systems", "menu", "debug"
+};
+
+//Histogram bins - bin n: 2^n to 2^(n+1)-1 cycles
+static const uint8_t prof_bins_nr= 32;
+
+//Debug port commands
+static const char prof_cmd_dump= 'p';	//Print all zones (one zone each call)
+static const char prof_cmd_reset= 'r';	//Reset all zones
+
+//No dump in progress
+static const uint8_t prof_dump_none= 0xFF;
+
+//Commands and dump period - one zone sent each period [ms]
+static const uint8_t prof_period= 100;
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+#ifdef PROFILER_ENABLED
+typedef struct{
+	uint32_t count;						//Zone executions
+	uint32_t min;						//Cycles
+	uint32_t max;
+	uint64_t total;						//Cycles of all executions (average)
+	uint32_t histogram[prof_bins_nr];	//Executions per log2 of the cycles
+}_prof_zone;
+
+_prof_zone prof_zones[prof_zones_nr];
+
+//Next zone printed (prof_dump_none: no dump)
+uint8_t prof_dump_zone;
+
+//Mark the zone start and record its cycles on the zone end (same scope)
+#define PROF_BEGIN(zone) uint32_t prof_start_##zone= DWT->CYCCNT
+#define PROF_END(zone) profiler_record(zone, DWT->CYCCNT - prof_start_##zone)
+#else
+#define PROF_BEGIN(zone)
+#define PROF_END(zone)
+#endif
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the cycle counter and reset all zones
+ * ----------------------------------------------------------------*/
+void profiler_init();
+
+/*------------------------------------------------------------------
+ * Reset all zones
+ * ----------------------------------------------------------------*/
+void profiler_reset();
+
+/*------------------------------------------------------------------
+ * Record an execution of @zone with @cycles
+ * ----------------------------------------------------------------*/
+void profiler_record(uint8_t zone, uint32_t cycles);
+
+/*------------------------------------------------------------------
+ * Debug port commands and dump - called from main loop each prof_period
+ * ----------------------------------------------------------------*/
+void manage_profiler();
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+#ifdef PROFILER_ENABLED
+/*------------------------------------------------------------------
+ * Initialize the cycle counter and reset all zones
+ * ----------------------------------------------------------------*/
+void profiler_init(){
+	//Trace enabled - DWT cycle counter running at the core clock
+	CoreDebug->DEMCR|= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT= 0;
+	DWT->CTRL|= DWT_CTRL_CYCCNTENA_Msk;
+
+	prof_dump_zone= prof_dump_none;
+	profiler_reset();
+}
+
+/*------------------------------------------------------------------
+ * Reset all zones
+ * ----------------------------------------------------------------*/
+void profiler_reset(){
+	memset(prof_zones, 0, sizeof(prof_zones));
+
+	for(uint8_t i= 0; i < prof_zones_nr; i++)
+		prof_zones[i].min= 0xFFFFFFFF;
+}
+
+/*------------------------------------------------------------------
+ * Record an execution of @zone with @cycles
+ * Bin of the histogram by the leading zeros (one instruction - CLZ)
+ * ----------------------------------------------------------------*/
+void profiler_record(uint8_t zone, uint32_t cycles){
+	_prof_zone *prof= &prof_zones[zone];
+
+	prof->count++;
+	prof->total+= cycles;
+	if(cycles < prof->min)
+		prof->min= cycles;
+	if(cycles > prof->max)
+		prof->max= cycles;
+
+	prof->histogram[31 - __builtin_clz(cycles | 1)]++;
+}
+
+/*------------------------------------------------------------------
+ * Debug port commands and dump - called from main loop each 100ms
+ * One zone printed each call (bounded serial time), histogram bins
+ * without executions are not printed. Cycles at SystemCoreClock
+ * ----------------------------------------------------------------*/
+void manage_profiler(){
+	while(Serial.available() > 0){
+		switch(Serial.read()){
+			case prof_cmd_dump:
+				prof_dump_zone= 0;
+				break;
+			case prof_cmd_reset:
+				profiler_reset();
+				break;
+		}
+	}
+
+	if(prof_dump_zone >= prof_zones_nr){
+		prof_dump_zone= prof_dump_none;
+		return;
+	}
+
+	_prof_zone *prof= &prof_zones[prof_dump_zone];
+
+	Serial.print("PROF ");
+	Serial.print(prof_zone_names[prof_dump_zone]);
+	Serial.print(" n=");
+	Serial.print(prof->count);
+	if(prof->count > 0){
+		Serial.print(" min=");
+		Serial.print(prof->min);
+		Serial.print(" max=");
+		Serial.print(prof->max);
+		Serial.print(" avg=");
+		Serial.print((uint32_t)(prof->total / prof->count));
+		for(uint8_t i= 0; i < prof_bins_nr; i++){
+			if(!prof->histogram[i])
+				continue;
+			Serial.print(" ");
+			Serial.print(i);
+			Serial.print(":");
+			Serial.print(prof->histogram[i]);
+		}
+	}
+	Serial.println();
+
+	prof_dump_zone++;
+}
+#else
+void profiler_init(){}
+void profiler_reset(){}
+void profiler_record(uint8_t zone, uint32_t cycles){}
+void manage_profiler(){}
+#endif
+
+
+#endif /* PROFILER_H_ */
@@ -0,0 +1,197 @@
+/*
+ * protection.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Reverse power protection - fast path PV curtailment
+ */
+
+#ifndef PROTECTION_H_
+#define PROTECTION_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include "pv_modbus.h"
+#include "genset_modbus.h"
+#include "curtailment.h"
+#include "digital_inputs_functions.h"
+#include "sequence_of_events.h"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Default PV limit while tripped [0.1% of nominal_power]
+static const uint16_t protection_power_limit_default= 0; //0.0%
+
+//Default time without new trip condition to release the protection
+static const uint32_t protection_hold_time_default= 5000; //5s
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+//Configuration
+uint16_t protection_power_limit;	//PV limit while tripped [0.1% of nominal_power]
+uint32_t protection_hold_time;		//Time to release the protection [ms]
+
+//Protection state
+bool protection_tripped;			//PV curtailed by protection
+uint32_t protection_trip_time;		//Last trip condition [ms]
+uint32_t protection_detection_time;	//Detection of the active trip [us]
+bool protection_command_pending;	//Protection setpoints waiting for the PV bus
+bool protection_ack_pending;		//Protection setpoints waiting for acknowledge
+
+//Detection to command latency [us]
+typedef struct{
+	uint16_t trips;				//Number of trips
+	uint32_t command_last;		//Detection to first protection write on PV bus
+	uint32_t command_max;
+	uint32_t ack_last;			//Detection to all protection writes acknowledged
+	uint32_t ack_max;
+}_protection_latency;
+
+_protection_latency protection_latency;
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the protection
+ * ----------------------------------------------------------------*/
+void protection_init();
+
+/*------------------------------------------------------------------
+ * Trip the protection - curtail the PV system to protection_power_limit
+ * @detection_time is the time [us] the trip condition was detected
+ * ----------------------------------------------------------------*/
+void protection_trip(uint32_t detection_time);
+
+/*------------------------------------------------------------------
+ * Return true if protection setpoints are waiting for the PV bus
+ * ----------------------------------------------------------------*/
+bool protection_pending();
+
+/*------------------------------------------------------------------
+ * Signal that the PV bus started the protection writes
+ * ----------------------------------------------------------------*/
+void protection_commanded();
+
+/*------------------------------------------------------------------
+ * Manage the trip conditions - called from main loop each 1ms
+ * ----------------------------------------------------------------*/
+void manage_protection();
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the protection
+ * ----------------------------------------------------------------*/
+void protection_init(){
+	protection_power_limit= protection_power_limit_default;
+	protection_hold_time= protection_hold_time_default;
+
+	protection_tripped= false;
+	protection_trip_time= 0;
+	protection_detection_time= 0;
+	protection_command_pending= false;
+	protection_ack_pending= false;
+
+	protection_latency.trips= 0;
+	protection_latency.command_last= 0;
+	protection_latency.command_max= 0;
+	protection_latency.ack_last= 0;
+	protection_latency.ack_max= 0;
+}
+
+/*------------------------------------------------------------------
+ * Trip the protection - curtail the PV system to protection_power_limit
+ * @detection_time is the time [us] the trip condition was detected
+ * ----------------------------------------------------------------*/
+void protection_trip(uint32_t detection_time){
+	protection_trip_time= millis();
+
+	//Already tripped - trip condition only extends the hold time
+	if(protection_tripped)
+		return;
+
+	protection_tripped= true;
+	protection_detection_time= detection_time;
+	protection_latency.trips++;
+	soe_record(soe_protection_trip, 0, 0, detection_time);
+
+	//Curtailment restarts from the protection limit after the release
+	curtailment_pv_limit= (int32_t)(((int64_t)pv_nominal_power_total * protection_power_limit) / 1000);
+	curtailment_pv_limit_percent= protection_power_limit;
+	pi_reset(&curtailment_pi, curtailment_pv_limit);
+	ramp_reset(&curtailment_ramp, curtailment_pv_limit);
+
+	//Protection setpoints - written ahead of any PV reading (broadcast if possible)
+	pv_set_fleet_power_limit(protection_power_limit, protection_trip_time);
+	protection_command_pending= true;
+	protection_ack_pending= true;
+}
+
+/*------------------------------------------------------------------
+ * Return true if protection setpoints are waiting for the PV bus
+ * ----------------------------------------------------------------*/
+bool protection_pending(){
+	return(protection_command_pending);
+}
+
+/*------------------------------------------------------------------
+ * Signal that the PV bus started the protection writes
+ * ----------------------------------------------------------------*/
+void protection_commanded(){
+	protection_command_pending= false;
+
+	protection_latency.command_last= micros() - protection_detection_time;
+	if(protection_latency.command_last > protection_latency.command_max)
+		protection_latency.command_max= protection_latency.command_last;
+}
+
+/*------------------------------------------------------------------
+ * Manage the trip conditions - called from main loop each 1ms
+ * ----------------------------------------------------------------*/
+void manage_protection(){
+	//Reverse power detected on genset active power samples
+	if(genset_flag_sync & genset_sync_reverse_power){
+		genset_flag_sync&= ~genset_sync_reverse_power; //Reset flag
+		protection_trip(genset_reverse_power_time);
+	}
+
+	//External reverse power relay - trip on the function activation
+	if(di_function_events & (1 << dif_reverse_power)){
+		di_function_events&= ~(1 << dif_reverse_power); //Reset event
+		if(di_functions.dif_reverse_power_trip == external_trip_active)
+			protection_trip(micros());
+	}
+
+	if(!protection_tripped)
+		return;
+
+	//All connected nodes acknowledged the protection setpoint
+	if(protection_ack_pending && !protection_command_pending && !pv_setpoint_pending()){
+		protection_ack_pending= false;
+
+		protection_latency.ack_last= micros() - protection_detection_time;
+		if(protection_latency.ack_last > protection_latency.ack_max)
+			protection_latency.ack_max= protection_latency.ack_last;
+	}
+
+	//Release - no trip condition during the hold time, no genset in reverse
+	//power and external relay released
+	if(((uint32_t)(millis() - protection_trip_time) >= protection_hold_time) &&
+	   !genset_reverse_power_nodes &&
+	   (di_functions.dif_reverse_power_trip != external_trip_active)){
+		protection_tripped= false;
+	}
+}
+
+
+#endif /* PROTECTION_H_ */
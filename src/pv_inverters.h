@@ -29,17 +29,25 @@ public:
 	static const uint16_t nominal_power= 5001; 			//Register address - Nominal power of inverter
 	static const uint8_t nominal_power_nr= 1; 			//Number of registers
 	static const float nominal_power_scale;				//Scale for conversion (value= received * scale)
+	static const int32_t nominal_power_w_mul= 100;		//Integer conversion to W (value= received * mul / div)
+	static const int32_t nominal_power_w_div= 1;		//(0.1 kW= 100 W)
 	typedef uint16_t PV_NOMINAL_POWER_DATA;				//Data type
 
 	static const uint16_t active_power= 5031;			//Register address - Actual active power generated
 	static const uint8_t active_power_nr= 2;			//Number of registers
 	static const float active_power_scale;				//Scale for conversion (value= received * scale)
+	static const int32_t active_power_w_mul= 1;			//Integer conversion to W (value= received * mul / div)
+	static const int32_t active_power_w_div= 1;
 	typedef uint32_t PV_TOTAL_ACTIVE_POWER_DATA;		//Data type
 
 	//WRITE - HOLDING REGISTERS (FUNCTION 0x06)
+	static const bool broadcast_write= true;			//Accepts write requests to broadcast address (0)
+
 	static const uint16_t enable_power_limit= 5007;		//Register address - Enable the power limitation of inverter
 														//Enable= 0xAA; Disable= 0x55
 	static const uint8_t enable_power_limit_nr= 1;		//Number of registers
+	static const uint16_t enable_power_limit_on= 0xAA;	//Enable the power limitation
+	static const uint16_t enable_power_limit_off= 0x55;	//Disable the power limitation
 	typedef uint16_t PV_ENABLE_POWER_LIMIT_DATA; 		//Data type
 	//No scale
 
@@ -52,6 +60,14 @@ public:
 	static const uint8_t power_limit_kw_nr= 2;			//Number of registers
 	static const float power_limit_kw_scale;			//Scale for conversion (value_to_send= value_limitation / scale)
 	typedef uint16_t PV_POWER_LIMIT_KW_DATA;			//Data type
+
+	//SETPOINT VERIFICATION - HOLDING REGISTERS (FUNCTION 0x03 / 0x17)
+	static const bool read_write_multiple= false;		//Read/write multiple registers (0x17) not supported
+	static const uint16_t setpoint_readback= 5007;		//First register read back after a setpoint write
+	static const uint8_t setpoint_readback_nr= 2;		//Number of registers
+	static const uint8_t setpoint_readback_enable= 0;	//Offset of enable_power_limit on read back
+	static const uint8_t setpoint_readback_limit= 1;	//Offset of power_limit_percent on read back
+	static const uint8_t setpoint_readback_active_power= 0xFF; //Active power not mapped on holding registers
 };
 //Init the float members
 const float Sungrow::nominal_power_scale= 0.1;
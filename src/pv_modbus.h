@@ -17,6 +17,8 @@
 #include "pv_inverters.h"
 #include "hal/board.h"
 #include "rs485.h"
+#include "energy.h"
+#include "sequence_of_events.h"
 
 
 /*------------------------------------------------------------------
@@ -27,11 +29,47 @@ static const uint16_t pv_sync_none  		= 0x0000; //No comunication ongoing
 static const uint16_t pv_sync_active_power  = 0x0001; //New active power read from any node
 static const uint16_t pv_sync_nominal_power = 0x0002; //New nominal power read from any node
 static const uint16_t pv_sync_comm_status   = 0x0004; //New communication status from any node
+static const uint16_t pv_sync_power_limit   = 0x0008; //Power limit acknowledged by any node
+static const uint16_t pv_sync_enable_power_limit= 0x0010; //Setpoint frame without power limit (transaction only)
+static const uint16_t pv_sync_broadcast		= 0x0020; //Write to all nodes (transaction only)
+static const uint16_t pv_sync_verify_power_limit= 0x0040; //Power limit read back (transaction only)
 
 //Node communication status control
 static const uint8_t pv_min_comm_errors= 0x00; //Pass from timeout to connected
 static const uint8_t pv_max_comm_errors= 0x03; //Pass from timeout to disconnected
 
+//Default maximum age of each variable to be used on totals
+static const uint32_t pv_active_power_max_age_default= 10000; 	//10s
+static const uint32_t pv_nominal_power_max_age_default= 60000; 	//60s
+
+//Power limit setpoints
+static const uint16_t pv_power_limit_max= 1000; 	//No limitation (100.0%)
+static const uint16_t pv_power_limit_unknown= 0xFFFF; //Limit of node not known (startup or reconnection)
+static const uint32_t pv_setpoint_latency_bound_default= 1000; //Genset sample to write acknowledge [ms]
+
+//Setpoint write plan - adjacent registers written in one frame (0x10)
+static const uint8_t pv_write_frame_max_registers= 4;	//Registers per frame
+static const uint8_t pv_write_plan_max_frames= 4;		//Frames per node setpoint
+
+//Setpoint write plan frame functions
+static const uint8_t pv_frame_write= 0x00;		//Write registers (0x06 / 0x10)
+static const uint8_t pv_frame_write_read= 0x01;	//Write and read back in one transaction (0x17)
+static const uint8_t pv_frame_read= 0x02;		//Read back only (0x03)
+static const uint8_t pv_readback_none= 0xFF;	//Variable not mapped on read back
+
+//Setpoint write retries after a read back mismatch
+static const uint8_t pv_setpoint_verify_retries= 2;
+
+//Broadcast writes - one frame for all nodes, no answer
+static const uint16_t pv_turnaround_delay_default= 100; //Time for the nodes to process a broadcast [ms]
+
+//Bus priority classes - higher class preempts the lower ones on the next transaction boundary
+static const uint8_t pv_class_protection= 0;	//Protection setpoints
+static const uint8_t pv_class_setpoint= 1;		//Curtailment setpoints (write and read back)
+static const uint8_t pv_class_fast_read= 2;		//Active power (control loop measurement)
+static const uint8_t pv_class_slow_read= 3;		//Nominal power
+static const uint16_t pv_starvation_time_default= 500; //Reads waiting longer are served first [ms]
+
 
 /*------------------------------------------------------------------
  * 					GLOBAL VARIABLES
@@ -43,6 +81,12 @@ ModbusMaster pv_node;
 typedef struct{
 	volatile uint32_t active_power;  //Actual deliverable power (ADP)
 	volatile uint32_t nominal_power; //Deliverable power (DP)
+
+	//Acquisition time of each variable [ms]
+	volatile uint32_t active_power_time;
+	volatile uint32_t nominal_power_time;
+	//Variables already read from node (pv_sync_* mask)
+	volatile uint16_t sampled_variables;
 }_pv_node_modbus_data;
 
 //Each node information
@@ -58,20 +102,103 @@ typedef struct{
 
 	_pv_node_modbus_data node_modbus_variables;
 
+	//Active power integration
+	_energy_integrator node_energy;
+
+	//Power limit [0.1% of nominal_power]
+	uint16_t power_limit_setpoint;		//Setpoint to be written
+	uint32_t power_limit_sample_time;	//Genset sample time used to compute the setpoint [ms]
+	uint16_t power_limit_acknowledged;	//Last setpoint acknowledged by node (pv_power_limit_unknown if none)
+	uint8_t power_limit_retries;		//Writes of the setpoint not confirmed by read back (reset on a new setpoint)
+
 }_pv_modbus_node;
 
 //All nodes access
 _pv_modbus_node pv_nodes[pv_max_nodes];
 
 //PV system total calculation
-uint32_t pv_active_power_total; //Actual deliverable power (ADPt) - Sum of all inverters
-uint32_t pv_nominal_power_total; //Deliverable power total (DPt) - Sum of all inverters
+int32_t pv_active_power_total;  //Actual deliverable power (ADPt) [W] - Sum of all inverters
+int32_t pv_nominal_power_total; //Deliverable power total (DPt) [W] - Sum of all inverters
+int64_t pv_energy_total;		  //Active energy [W.ms] - Sum of all inverters
+
+//Staleness of each total calculation
+typedef struct{
+	uint32_t max_age;		//Maximum age of a value to be used on total [ms]
+	uint32_t oldest_time;	//Acquisition time of the oldest value used on total [ms]
+	uint32_t newest_time;	//Acquisition time of the newest value used on total [ms]
+	uint32_t stale_nodes;	//Nodes excluded from total - stale values (bit per node)
+	uint8_t contributors;	//Number of values used on total
+}_pv_total_status;
+
+_pv_total_status pv_active_power_status;	//Active power total (ADPt) staleness
+_pv_total_status pv_nominal_power_status;	//Nominal power total (DPt) staleness
+
+//Nodes with power limit setpoint waiting to be written (bit per node)
+uint32_t pv_setpoint_pending_nodes;
+
+//Nodes with the setpoint not confirmed after all read back retries (bit per node)
+//Reset on the next setpoint confirmed by the node
+uint32_t pv_setpoint_failed_nodes;
+
+//Setpoint registers written in one frame
+typedef struct{
+	uint8_t function;	//pv_frame_write, pv_frame_write_read or pv_frame_read
+	uint16_t address;	//First register
+	uint8_t quantity;	//Number of adjacent registers
+	uint16_t value[pv_write_frame_max_registers];
+	bool setpoint;		//Frame carries the power limit (acknowledge)
+}_pv_write_frame;
+
+//Holding registers read back to verify the setpoint
+typedef struct{
+	uint16_t address;		//First register
+	uint8_t quantity;		//Number of registers (0= no verification)
+	uint8_t enable;			//Offset of the enable register (pv_readback_none if not mapped)
+	uint16_t enable_value;	//Expected enable value
+	uint8_t limit;			//Offset of the power limit register
+	uint8_t active_power;	//Offset of the active power, 2 registers low word first (pv_readback_none if not mapped)
+}_pv_setpoint_readback;
+
+//Frames of a node setpoint write
+typedef struct{
+	_pv_write_frame frame[pv_write_plan_max_frames];
+	uint8_t frames;
+	_pv_setpoint_readback readback;
+}_pv_write_plan;
+
+_pv_write_plan pv_write_plan; //Plan of the setpoint being written
+
+//Setpoint verification by read back
+bool pv_setpoint_verify;			//Read back the setpoints written node by node
+uint16_t pv_setpoint_verify_errors; //Read back different from the setpoint written
+
+//Fleet power limit waiting to be written by broadcast
+bool pv_broadcast_enabled;	//Broadcast allowed on PV bus
+bool pv_broadcast_pending;	//Same setpoint loaded on all nodes - write in one frame
+
+//Setpoint writes holding the bus (frames of a node plan or broadcast left)
+bool pv_write_ongoing;
+
+//Latency from genset sample to power limit write acknowledge
+typedef struct{
+	uint32_t last;			//Last latency measured [ms]
+	uint32_t max;			//Maximum latency measured [ms]
+	uint32_t bound;			//Maximum latency allowed [ms]
+	uint16_t violations;	//Latencies measured above the bound
+}_pv_setpoint_latency;
+
+_pv_setpoint_latency pv_setpoint_latency;
+
+//Last power limit acknowledged by any node [ms]
+uint32_t pv_setpoint_ack_time;
 
 //Modbus new data available synchronization flag
 uint16_t pv_flag_sync;
 
 //Modbus transactions synchronization
 uint8_t pv_global_node_index; 	//Used for update node communication status
+uint16_t pv_global_setpoint;	//Power limit being written
+uint32_t pv_global_setpoint_sample_time; //Genset sample time of the power limit being written
 uint16_t pv_variable_modbus; 	//Used to identify the modbus transaction for successful transaction
 								//callback function and for main loop scheduler
 
@@ -111,11 +238,76 @@ bool pv_read_modbus_variables(uint8_t pv_node_read);
  *----------------------------------------------------------------*/
 void pv_read_modbus_variables();
 
+/*------------------------------------------------------------------
+ *Write the pending power limit setpoints to PV system
+ *Return true if transactions are finished (with success or not)
+ *----------------------------------------------------------------*/
+bool pv_write_modbus_setpoints();
+
+/*------------------------------------------------------------------
+ *Return true if some connected node has a setpoint to be written
+ *or the writes in progress did not finish (read back frames)
+ *----------------------------------------------------------------*/
+bool pv_setpoint_pending();
+
+/*------------------------------------------------------------------
+ *Return true if some connected node did not confirm its setpoint
+ *after all read back retries
+ *----------------------------------------------------------------*/
+bool pv_setpoint_failed();
+
+/*------------------------------------------------------------------
+ *Set the power @limit [0.1%] of @node_index
+ *@sample_time is the genset sample time used to compute the limit
+ *----------------------------------------------------------------*/
+void pv_set_power_limit(uint8_t node_index, uint16_t limit, uint32_t sample_time);
+
+/*------------------------------------------------------------------
+ *Set the same power @limit [0.1%] to all nodes
+ *Written by broadcast if all nodes accept it
+ *@sample_time is the genset sample time used to compute the limit
+ *----------------------------------------------------------------*/
+void pv_set_fleet_power_limit(uint16_t limit, uint32_t sample_time);
+
+/*------------------------------------------------------------------
+ *Node type shared by all configured nodes if the setpoints can be
+ *written by broadcast, NoInverter otherwise
+ *----------------------------------------------------------------*/
+inverters pv_broadcast_node_type();
+
+/*------------------------------------------------------------------
+ *Set the turnaround delay [ms] after broadcast writes
+ *----------------------------------------------------------------*/
+void pv_set_turnaround_delay(uint16_t new_delay);
+
 /*------------------------------------------------------------------
  *Manage modbus variables for PV system - called from main loop
  *----------------------------------------------------------------*/
 void manage_pv_system();
 
+/*------------------------------------------------------------------
+ *Set the maximum age [ms] of @variable (pv_sync_*) to be used on totals
+ *----------------------------------------------------------------*/
+void pv_set_max_age(uint16_t variable, uint32_t max_age);
+
+/*------------------------------------------------------------------
+ *Sum @variable (pv_sync_*) of all nodes in W, excluding stale values
+ *@status receives the stale nodes and the oldest value used
+ *----------------------------------------------------------------*/
+int32_t pv_aggregate(uint16_t variable, _pv_total_status *status);
+
+/*------------------------------------------------------------------
+ *Check if the oldest value used on totals exceeded its maximum age
+ *Called from main loop - set the flag to recalculate the totals
+ *----------------------------------------------------------------*/
+void pv_check_stale_values();
+
+/*------------------------------------------------------------------
+ *Age [ms] of the oldest value used on total of @status
+ *Return 0xFFFFFFFF if no value was used
+ *----------------------------------------------------------------*/
+uint32_t pv_oldest_age(const _pv_total_status *status);
+
 /*------------------------------------------------------------------
  *Callback function for all successful modbus transactions
  *----------------------------------------------------------------*/
@@ -131,6 +323,32 @@ void pv_timeout_transaction();
  * ----------------------------------------------------------------*/
 uint8_t pv_read_active_power(uint8_t node_index);
 
+/*-----------------------------------------------------------------
+ * Build the setpoint write plan of a node of @type
+ * Adjacent holding registers are merged in the same frame
+ * If @readback the setpoint is read back - in the same transaction
+ * (0x17) if the node supports it, otherwise in a separate one (0x03)
+ * ----------------------------------------------------------------*/
+void pv_build_write_plan(inverters type, uint16_t setpoint, bool readback, _pv_write_plan *plan);
+
+/*-----------------------------------------------------------------
+ * Verify the setpoint read back of @node_index from the response buffer
+ * ----------------------------------------------------------------*/
+void pv_verify_setpoint(uint8_t node_index);
+
+/*-----------------------------------------------------------------
+ * Add the register write @address= @value to @plan
+ * @setpoint identifies the power limit register (acknowledge)
+ * ----------------------------------------------------------------*/
+void pv_write_plan_add(_pv_write_plan *plan, uint16_t address, uint16_t value, bool setpoint);
+
+/*-----------------------------------------------------------------
+ * Write the frame @frame_index of the setpoint write plan to the node
+ * @node_index (@broadcast= all nodes, @node_index not used)
+ * The plan is built when the first frame starts
+ * ----------------------------------------------------------------*/
+uint8_t pv_write_setpoint(uint8_t node_index, uint8_t frame_index, bool broadcast);
+
 /*-----------------------------------------------------------------
  * Read nominal power from specified node
  * Return the transaction status:
@@ -146,6 +364,22 @@ uint8_t pv_read_nominal_power(uint8_t node_index);
  *----------------------------------------------------------------*/
 void pv_update_communication_status(uint8_t node_index, bool sucess);
 
+/*------------------------------------------------------------------
+ *Store the @active_power sample of @node_index received at @sample_time
+ *[ms] - energy integrated, new active power signaled
+ *----------------------------------------------------------------*/
+void pv_store_active_power(uint8_t node_index, uint32_t active_power, uint32_t sample_time);
+
+/*------------------------------------------------------------------
+ *Convert the @active_power received from @node_index to W
+ *----------------------------------------------------------------*/
+int32_t pv_active_power_to_w(uint8_t node_index, uint32_t active_power);
+
+/*------------------------------------------------------------------
+ *Convert the @nominal_power received from @node_index to W
+ *----------------------------------------------------------------*/
+int32_t pv_nominal_power_to_w(uint8_t node_index, uint32_t nominal_power);
+
 
 
 
@@ -170,6 +404,10 @@ void pv_init_modbus(uint8_t addr){
 	pv_node.querySuccess(pv_successful_transaction);
 	//Called on transaction timeout
 	pv_node.queryTimeout(pv_timeout_transaction);
+	//Time for the nodes to process broadcast writes
+	pv_node.setTurnaroundDelay(pv_turnaround_delay_default);
+	//Reads waiting longer are served before the setpoint writes
+	pv_node.setStarvationTime(pv_starvation_time_default);
 
 	//Init nodes information
 	for(int i= 0; i < pv_max_nodes; i++){
@@ -179,15 +417,52 @@ void pv_init_modbus(uint8_t addr){
 		pv_nodes[i].node_comm_error_counter= 0;
 		pv_nodes[i].node_modbus_variables.active_power= 0x0000;
 		pv_nodes[i].node_modbus_variables.nominal_power= 0x0000;
+		pv_nodes[i].node_modbus_variables.active_power_time= 0;
+		pv_nodes[i].node_modbus_variables.nominal_power_time= 0;
+		pv_nodes[i].node_modbus_variables.sampled_variables= pv_sync_none;
+		energy_init(&pv_nodes[i].node_energy);
+		pv_nodes[i].power_limit_setpoint= pv_power_limit_max;
+		pv_nodes[i].power_limit_sample_time= 0;
+		pv_nodes[i].power_limit_acknowledged= pv_power_limit_unknown;
+		pv_nodes[i].power_limit_retries= 0;
 	}
 
 	//Synchronization variables
 	pv_global_node_index= 0;
+	pv_global_setpoint= pv_power_limit_max;
+	pv_global_setpoint_sample_time= 0;
 	pv_variable_modbus&= pv_sync_none;
 
 	//PV system total calculation
 	pv_active_power_total= 0;  //Actual deliverable power (ADPt) - Sum of all inverters
 	pv_nominal_power_total= 0; //Deliverable power total (DPt) - Sum of all inverters
+	pv_energy_total= 0;
+
+	//Totals staleness
+	pv_active_power_status.max_age= pv_active_power_max_age_default;
+	pv_active_power_status.oldest_time= 0;
+	pv_active_power_status.newest_time= 0;
+	pv_active_power_status.stale_nodes= 0;
+	pv_active_power_status.contributors= 0;
+	pv_nominal_power_status.max_age= pv_nominal_power_max_age_default;
+	pv_nominal_power_status.oldest_time= 0;
+	pv_nominal_power_status.newest_time= 0;
+	pv_nominal_power_status.stale_nodes= 0;
+	pv_nominal_power_status.contributors= 0;
+
+	//Power limit setpoints
+	pv_setpoint_pending_nodes= 0;
+	pv_setpoint_failed_nodes= 0;
+	pv_broadcast_enabled= true;
+	pv_setpoint_verify= true;
+	pv_setpoint_verify_errors= 0;
+	pv_broadcast_pending= false;
+	pv_write_ongoing= false;
+	pv_setpoint_latency.last= 0;
+	pv_setpoint_latency.max= 0;
+	pv_setpoint_latency.bound= pv_setpoint_latency_bound_default;
+	pv_setpoint_latency.violations= 0;
+	pv_setpoint_ack_time= 0;
 
 	//Modbus new data available synchronization flag
 	pv_flag_sync&= pv_sync_none;
@@ -220,6 +495,13 @@ void pv_set_timeout(uint16_t new_timeout){
 	pv_node.setTimeout(new_timeout);
 }
 
+/*------------------------------------------------------------------
+ *Set the turnaround delay [ms] after broadcast writes
+ *----------------------------------------------------------------*/
+void pv_set_turnaround_delay(uint16_t new_delay){
+	pv_node.setTurnaroundDelay(new_delay);
+}
+
 /*------------------------------------------------------------------
  *Read modbus variables from PV system
  *Return true if transaction is finished (with success or not)
@@ -251,24 +533,178 @@ bool pv_read_modbus_variables(uint8_t pv_node_read){
 	return(false);
 }
 
+/*------------------------------------------------------------------
+ *Write the pending power limit setpoints to PV system
+ *Return true if transactions are finished (with success or not)
+ *----------------------------------------------------------------*/
+bool pv_write_modbus_setpoints(){
+	static uint8_t frame_index= 0; //Frame of the write plan of the node
+	static uint8_t node_index= 0;
+	static bool broadcast= false; //Broadcast transactions ongoing
+
+	//Fleet setpoint - broadcast on the next transaction boundary
+	if(!broadcast && pv_broadcast_pending && (pv_node.getTransactionStatus() != transaction_receveing)){
+		broadcast= true;
+		pv_broadcast_pending= false;
+		frame_index= 0;
+		pv_variable_modbus&= ~(pv_sync_enable_power_limit | pv_sync_power_limit | pv_sync_verify_power_limit);
+	}
+
+	if(broadcast){
+		uint8_t result= pv_write_setpoint(0, frame_index, true);
+		if(result == transaction_idle){
+			//Next frame - nodes not covered by the broadcast are written node by node
+			if(++frame_index >= pv_write_plan.frames){
+				frame_index= 0;
+				broadcast= false;
+				node_index= 0;
+			}
+		}
+		else if(result == transaction_timeout){
+			//Broadcast not possible - write node by node
+			frame_index= 0;
+			broadcast= false;
+			node_index= 0;
+		}
+		pv_write_ongoing= broadcast;
+		return(false);
+	}
+
+	//Next node with setpoint to be written - skip disconnected nodes
+	//(the node keeps the bus until the last frame of its plan)
+	while((frame_index == 0) && (node_index < pv_max_nodes) &&
+		 (!(pv_setpoint_pending_nodes & ((uint32_t)1 << node_index)) ||
+		  (pv_nodes[node_index].node_communication_status == disconnected))){
+		node_index++;
+	}
+	//All pending setpoints written
+	if(node_index >= pv_max_nodes){
+		node_index= 0;
+		pv_write_ongoing= false;
+		return(true);
+	}
+
+	uint8_t result= pv_write_setpoint(node_index, frame_index, false);
+	if(result == transaction_idle){
+		//Next frame or next node
+		if(++frame_index >= pv_write_plan.frames){
+			frame_index= 0;
+			node_index++;
+		}
+	}
+	else if(result == transaction_timeout){
+		//Next node
+		frame_index= 0;
+		node_index++;
+	}
+	pv_write_ongoing= (frame_index != 0);
+
+	return(false);
+}
+
+/*------------------------------------------------------------------
+ *Return true if some connected node has a setpoint to be written
+ *or the writes in progress did not finish (read back frames)
+ *----------------------------------------------------------------*/
+bool pv_setpoint_pending(){
+	if(pv_write_ongoing || pv_broadcast_pending)
+		return(true);
+
+	for(uint8_t i= 0; i < pv_max_nodes; i++){
+		if((pv_setpoint_pending_nodes & ((uint32_t)1 << i)) &&
+		   (pv_nodes[i].node_communication_status != disconnected))
+			return(true);
+	}
+	return(false);
+}
+
+/*------------------------------------------------------------------
+ *Return true if some connected node did not confirm its setpoint
+ *after all read back retries
+ *----------------------------------------------------------------*/
+bool pv_setpoint_failed(){
+	for(uint8_t i= 0; i < pv_max_nodes; i++){
+		if((pv_setpoint_failed_nodes & ((uint32_t)1 << i)) &&
+		   (pv_nodes[i].node_communication_status != disconnected))
+			return(true);
+	}
+	return(false);
+}
+
+/*------------------------------------------------------------------
+ *Set the power @limit [0.1%] of @node_index
+ *@sample_time is the genset sample time used to compute the limit
+ *----------------------------------------------------------------*/
+void pv_set_power_limit(uint8_t node_index, uint16_t limit, uint32_t sample_time){
+	if((node_index >= pv_max_nodes) || (pv_nodes[node_index].node_type == NoInverter))
+		return;
+
+	if(limit > pv_power_limit_max)
+		limit= pv_power_limit_max;
+
+	//New setpoint - all read back retries available again
+	if(limit != pv_nodes[node_index].power_limit_setpoint)
+		pv_nodes[node_index].power_limit_retries= 0;
+
+	pv_nodes[node_index].power_limit_setpoint= limit;
+	pv_nodes[node_index].power_limit_sample_time= sample_time;
+	pv_setpoint_pending_nodes|= ((uint32_t)1 << node_index);
+}
+
+/*------------------------------------------------------------------
+ *Set the same power @limit [0.1%] to all nodes
+ *Written by broadcast if all nodes accept it
+ *@sample_time is the genset sample time used to compute the limit
+ *----------------------------------------------------------------*/
+void pv_set_fleet_power_limit(uint16_t limit, uint32_t sample_time){
+	for(uint8_t i= 0; i < pv_max_nodes; i++){
+		pv_set_power_limit(i, limit, sample_time);
+	}
+
+	if(pv_broadcast_enabled && (pv_broadcast_node_type() != NoInverter))
+		pv_broadcast_pending= true;
+}
+
+/*------------------------------------------------------------------
+ *Node type shared by all configured nodes if the setpoints can be
+ *written by broadcast, NoInverter otherwise
+ *----------------------------------------------------------------*/
+inverters pv_broadcast_node_type(){
+	inverters type= NoInverter;
+
+	for(uint8_t i= 0; i < pv_max_nodes; i++){
+		if(pv_nodes[i].node_type == NoInverter)
+			continue;
+		//Different register maps can not share the same frame
+		if((type != NoInverter) && (pv_nodes[i].node_type != type))
+			return(NoInverter);
+		type= pv_nodes[i].node_type;
+	}
+
+	switch (type) {
+		case Sungrow:
+				if(Sungrow::broadcast_write)
+					return(Sungrow);
+			break;
+		default:
+			break;
+	}
+
+	return(NoInverter);
+}
+
 /*------------------------------------------------------------------
  *Manage modbus variables for PV system - called from main loop
  *----------------------------------------------------------------*/
 void manage_pv_system(){
 	//New nominal power - recalculate total nominal power (DPt)
 	if(pv_flag_sync & pv_sync_nominal_power){
-		pv_nominal_power_total= 0x00000000;
-		for(uint8_t i= 0; i < pv_max_nodes; i++){
-			pv_nominal_power_total+= pv_nodes[i].node_modbus_variables.nominal_power;
-		}
+		pv_nominal_power_total= pv_aggregate(pv_sync_nominal_power, &pv_nominal_power_status);
 		pv_flag_sync&= ~pv_sync_nominal_power; //Reset flag
 	}
 	//New active power - recalculate total active power (ADPt)
 	if(pv_flag_sync & pv_sync_active_power){
-		pv_active_power_total= 0x00000000;
-		for(uint8_t i= 0; i < pv_max_nodes; i++){
-			pv_active_power_total+= pv_nodes[i].node_modbus_variables.active_power;
-		}
+		pv_active_power_total= pv_aggregate(pv_sync_active_power, &pv_active_power_status);
 		pv_flag_sync&= ~pv_sync_active_power; //Reset flag
 	}
 	//New communication status - some node has the communication status changed
@@ -278,44 +714,142 @@ void manage_pv_system(){
 	}
 }
 
+/*------------------------------------------------------------------
+ *Set the maximum age [ms] of @variable (pv_sync_*) to be used on totals
+ *----------------------------------------------------------------*/
+void pv_set_max_age(uint16_t variable, uint32_t max_age){
+	if(variable == pv_sync_active_power)
+		pv_active_power_status.max_age= max_age;
+	else if(variable == pv_sync_nominal_power)
+		pv_nominal_power_status.max_age= max_age;
+}
+
+/*------------------------------------------------------------------
+ *Sum @variable (pv_sync_*) of all nodes in W, excluding stale values
+ *@status receives the stale nodes and the oldest value used
+ *----------------------------------------------------------------*/
+int32_t pv_aggregate(uint16_t variable, _pv_total_status *status){
+	int32_t total= 0x00000000;
+	uint32_t now= millis();
+
+	status->oldest_time= now;
+	status->newest_time= 0;
+	status->stale_nodes= 0;
+	status->contributors= 0;
+
+	for(uint8_t i= 0; i < pv_max_nodes; i++){
+		volatile _pv_node_modbus_data *data= &pv_nodes[i].node_modbus_variables;
+
+		//Variable never read from this node
+		if(!(data->sampled_variables & variable))
+			continue;
+
+		int32_t value= (variable == pv_sync_active_power) ?
+				pv_active_power_to_w(i, data->active_power) : pv_nominal_power_to_w(i, data->nominal_power);
+		uint32_t sample_time= (variable == pv_sync_active_power) ? data->active_power_time : data->nominal_power_time;
+
+		//Stale value - excluded from total
+		if((uint32_t)(now - sample_time) > status->max_age){
+			status->stale_nodes|= ((uint32_t)1 << i);
+			continue;
+		}
+
+		total+= value;
+		status->contributors++;
+		if((int32_t)(sample_time - status->oldest_time) < 0)
+			status->oldest_time= sample_time;
+		if((status->contributors == 1) || ((int32_t)(sample_time - status->newest_time) > 0))
+			status->newest_time= sample_time;
+	}
+
+	return(total);
+}
+
+/*------------------------------------------------------------------
+ *Check if the oldest value used on totals exceeded its maximum age
+ *Called from main loop - set the flag to recalculate the totals
+ *----------------------------------------------------------------*/
+void pv_check_stale_values(){
+	if(pv_active_power_status.contributors &&
+	  (pv_oldest_age(&pv_active_power_status) > pv_active_power_status.max_age)){
+		pv_flag_sync|= pv_sync_active_power;
+	}
+	if(pv_nominal_power_status.contributors &&
+	  (pv_oldest_age(&pv_nominal_power_status) > pv_nominal_power_status.max_age)){
+		pv_flag_sync|= pv_sync_nominal_power;
+	}
+}
+
+/*------------------------------------------------------------------
+ *Age [ms] of the oldest value used on total of @status
+ *Return 0xFFFFFFFF if no value was used
+ *----------------------------------------------------------------*/
+uint32_t pv_oldest_age(const _pv_total_status *status){
+	if(status->contributors == 0)
+		return(0xFFFFFFFF);
+
+	return((uint32_t)(millis() - status->oldest_time));
+}
+
 /*------------------------------------------------------------------
  *Callback function for all successful modbus transactions
  *----------------------------------------------------------------*/
 void pv_successful_transaction(){
-	if(pv_variable_modbus & pv_sync_active_power){
+	if(pv_variable_modbus & pv_sync_broadcast){
+		//No answer - the nodes had the turnaround delay to process the write
+		if(pv_variable_modbus & pv_sync_power_limit){
+			for(uint8_t i= 0; i < pv_max_nodes; i++){
+				if(pv_nodes[i].node_type == NoInverter)
+					continue;
+
+				pv_nodes[i].power_limit_acknowledged= pv_global_setpoint;
+				//Setpoint not changed during the transaction
+				if(pv_nodes[i].power_limit_setpoint == pv_global_setpoint)
+					pv_setpoint_pending_nodes&= ~((uint32_t)1 << i);
+			}
+
+			//Latency from genset sample to end of turnaround
+			pv_setpoint_latency.last= pv_node.getResponseTime() - pv_global_setpoint_sample_time;
+			if(pv_setpoint_latency.last > pv_setpoint_latency.max)
+				pv_setpoint_latency.max= pv_setpoint_latency.last;
+			if(pv_setpoint_latency.last > pv_setpoint_latency.bound)
+				pv_setpoint_latency.violations++;
+
+			//Indicate that the nodes received a new power limit
+			pv_setpoint_ack_time= pv_node.getResponseTime();
+			pv_flag_sync|= pv_sync_power_limit;
+		}
+
+		//Reset flags
+		pv_variable_modbus&= ~(pv_sync_broadcast | pv_sync_enable_power_limit | pv_sync_power_limit);
+	}
+	else if(pv_variable_modbus & pv_sync_active_power){
 		uint32_t active_power= 0x00000000;
 		uint16_t register_low= pv_node.getResponseBuffer(0x00);
 		uint16_t register_high= pv_node.getResponseBuffer(0x01);
 
 		//Recovery the entire value
 		active_power|= register_high;
-		active_power<<= 8;
+		active_power<<= 16;
 		active_power|= register_low;
 
-		//Update Modbus variable
-		pv_nodes[pv_global_node_index].node_modbus_variables.active_power= active_power;
+		//Update Modbus variable - sample timestamp from the modbus engine
+		pv_store_active_power(pv_global_node_index, active_power, pv_node.getResponseTime());
 
 		//Update communication status - transaction success
 		pv_update_communication_status(pv_global_node_index, true);
 
-		//Indicate that there are new active power for some node
-		pv_flag_sync|= pv_sync_active_power;
-
 		//Reset flag
 		pv_variable_modbus&= ~pv_sync_active_power;
 	}
 	else if(pv_variable_modbus & pv_sync_nominal_power){
-		uint32_t nominal_power= 0x00000000;
-		uint16_t register_low= pv_node.getResponseBuffer(0x00);
-		uint16_t register_high= pv_node.getResponseBuffer(0x01);
-
-		//Recovery the entire value
-		nominal_power|= register_high;
-		nominal_power<<= 8;
-		nominal_power|= register_low;
+		//Single register value
+		uint32_t nominal_power= pv_node.getResponseBuffer(0x00);
 
 		//Update Modbus variable
 		pv_nodes[pv_global_node_index].node_modbus_variables.nominal_power= nominal_power;
+		pv_nodes[pv_global_node_index].node_modbus_variables.nominal_power_time= pv_node.getResponseTime();
+		pv_nodes[pv_global_node_index].node_modbus_variables.sampled_variables|= pv_sync_nominal_power;
 
 		//Update communication status - transaction success
 		pv_update_communication_status(pv_global_node_index, true);
@@ -326,6 +860,52 @@ void pv_successful_transaction(){
 		//Reset flag
 		pv_variable_modbus&= ~pv_sync_nominal_power;
 	}
+	else if(pv_variable_modbus & pv_sync_enable_power_limit){
+		//Update communication status - transaction success
+		pv_update_communication_status(pv_global_node_index, true);
+
+		//Reset flag
+		pv_variable_modbus&= ~pv_sync_enable_power_limit;
+	}
+	else if(pv_variable_modbus & pv_sync_power_limit){
+		_pv_modbus_node *node= &pv_nodes[pv_global_node_index];
+
+		node->power_limit_acknowledged= pv_global_setpoint;
+		//Setpoint not changed during the transaction
+		if(node->power_limit_setpoint == pv_global_setpoint)
+			pv_setpoint_pending_nodes&= ~((uint32_t)1 << pv_global_node_index);
+
+		//Latency from genset sample to write acknowledge
+		pv_setpoint_latency.last= pv_node.getResponseTime() - pv_global_setpoint_sample_time;
+		if(pv_setpoint_latency.last > pv_setpoint_latency.max)
+			pv_setpoint_latency.max= pv_setpoint_latency.last;
+		if(pv_setpoint_latency.last > pv_setpoint_latency.bound)
+			pv_setpoint_latency.violations++;
+
+		//Update communication status - transaction success
+		pv_update_communication_status(pv_global_node_index, true);
+
+		//Read back in the same transaction (0x17)
+		if(pv_variable_modbus & pv_sync_verify_power_limit)
+			pv_verify_setpoint(pv_global_node_index);
+
+		//Indicate that some node acknowledged a new power limit
+		pv_setpoint_ack_time= pv_node.getResponseTime();
+		pv_flag_sync|= pv_sync_power_limit;
+
+		//Reset flags
+		pv_variable_modbus&= ~(pv_sync_power_limit | pv_sync_verify_power_limit);
+	}
+	else if(pv_variable_modbus & pv_sync_verify_power_limit){
+		//Read back after the writes (0x03)
+		pv_verify_setpoint(pv_global_node_index);
+
+		//Update communication status - transaction success
+		pv_update_communication_status(pv_global_node_index, true);
+
+		//Reset flag
+		pv_variable_modbus&= ~pv_sync_verify_power_limit;
+	}
 }
 
 /*------------------------------------------------------------------
@@ -338,7 +918,11 @@ void pv_timeout_transaction(){
 	Serial.println("------------ PV Timeout -----------------");
 	Serial.println(pv_global_node_index);
 
-	if(pv_variable_modbus & pv_sync_active_power){
+	if(pv_variable_modbus & pv_sync_broadcast){
+		//Reset flags - setpoints remain pending
+		pv_variable_modbus&= ~(pv_sync_broadcast | pv_sync_enable_power_limit | pv_sync_power_limit);
+	}
+	else if(pv_variable_modbus & pv_sync_active_power){
 		//Reset flag
 		pv_variable_modbus&= ~pv_sync_active_power;
 	}
@@ -346,6 +930,18 @@ void pv_timeout_transaction(){
 		//Reset flag
 		pv_variable_modbus&= ~pv_sync_nominal_power;
 	}
+	else if(pv_variable_modbus & pv_sync_enable_power_limit){
+		//Reset flag
+		pv_variable_modbus&= ~pv_sync_enable_power_limit;
+	}
+	else if(pv_variable_modbus & pv_sync_power_limit){
+		//Reset flags - setpoint remains pending
+		pv_variable_modbus&= ~(pv_sync_power_limit | pv_sync_verify_power_limit);
+	}
+	else if(pv_variable_modbus & pv_sync_verify_power_limit){
+		//Reset flag - setpoint taken as acknowledged by the write
+		pv_variable_modbus&= ~pv_sync_verify_power_limit;
+	}
 }
 
 /*-----------------------------------------------------------------
@@ -433,6 +1029,216 @@ uint8_t pv_read_nominal_power(uint8_t node_index){
 	return(pv_node.readInputRegisters(register_to_read, number_of_registers));
 }
 
+/*-----------------------------------------------------------------
+ * Build the setpoint write plan of a node of @type
+ * Adjacent holding registers are merged in the same frame
+ * If @readback the setpoint is read back - in the same transaction
+ * (0x17) if the node supports it, otherwise in a separate one (0x03)
+ * ----------------------------------------------------------------*/
+void pv_build_write_plan(inverters type, uint16_t setpoint, bool readback, _pv_write_plan *plan){
+	bool read_write_multiple= false;
+
+	plan->frames= 0;
+	plan->readback.quantity= 0;
+
+	switch (type) {
+		case Sungrow:
+				//Enable (5007) and limit (5008) - one frame
+				pv_write_plan_add(plan, Sungrow::enable_power_limit, Sungrow::enable_power_limit_on, false);
+				pv_write_plan_add(plan, Sungrow::power_limit_percent, setpoint, true);
+
+				read_write_multiple= Sungrow::read_write_multiple;
+				plan->readback.address= Sungrow::setpoint_readback;
+				plan->readback.quantity= Sungrow::setpoint_readback_nr;
+				plan->readback.enable= Sungrow::setpoint_readback_enable;
+				plan->readback.enable_value= Sungrow::enable_power_limit_on;
+				plan->readback.limit= Sungrow::setpoint_readback_limit;
+				plan->readback.active_power= Sungrow::setpoint_readback_active_power;
+			break;
+		default:
+			break;
+	}
+
+	if(!readback || (plan->readback.quantity == 0)){
+		plan->readback.quantity= 0;
+		return;
+	}
+
+	//Read back on the frame carrying the power limit
+	if(read_write_multiple){
+		for(uint8_t i= 0; i < plan->frames; i++){
+			if(plan->frame[i].setpoint){
+				plan->frame[i].function= pv_frame_write_read;
+				return;
+			}
+		}
+	}
+
+	//Not supported - read back after the writes
+	if(plan->frames < pv_write_plan_max_frames){
+		_pv_write_frame *frame= &plan->frame[plan->frames++];
+		frame->function= pv_frame_read;
+		frame->address= plan->readback.address;
+		frame->quantity= 0;
+		frame->setpoint= false;
+	}
+}
+
+/*-----------------------------------------------------------------
+ * Add the register write @address= @value to @plan
+ * @setpoint identifies the power limit register (acknowledge)
+ * ----------------------------------------------------------------*/
+void pv_write_plan_add(_pv_write_plan *plan, uint16_t address, uint16_t value, bool setpoint){
+	for(uint8_t i= 0; i < plan->frames; i++){
+		_pv_write_frame *frame= &plan->frame[i];
+
+		if(frame->quantity >= pv_write_frame_max_registers)
+			continue;
+
+		//Register just after the frame
+		if(address == (frame->address + frame->quantity)){
+			frame->value[frame->quantity++]= value;
+			frame->setpoint|= setpoint;
+			return;
+		}
+		//Register just before the frame
+		if((address + 1) == frame->address){
+			for(uint8_t j= frame->quantity; j > 0; j--){
+				frame->value[j]= frame->value[j - 1];
+			}
+			frame->value[0]= value;
+			frame->address= address;
+			frame->quantity++;
+			frame->setpoint|= setpoint;
+			return;
+		}
+	}
+
+	//New frame
+	if(plan->frames >= pv_write_plan_max_frames)
+		return;
+
+	_pv_write_frame *frame= &plan->frame[plan->frames++];
+	frame->function= pv_frame_write;
+	frame->address= address;
+	frame->quantity= 1;
+	frame->value[0]= value;
+	frame->setpoint= setpoint;
+}
+
+/*-----------------------------------------------------------------
+ * Write the frame @frame_index of the setpoint write plan to the node
+ * @node_index (@broadcast= all nodes, @node_index not used)
+ * The plan is built when the first frame starts
+ * ----------------------------------------------------------------*/
+uint8_t pv_write_setpoint(uint8_t node_index, uint8_t frame_index, bool broadcast){
+	inverters type= NoInverter;
+	uint8_t node_for_setpoint= node_index;
+
+	if(broadcast){
+		//All nodes must share the same register map - setpoint of the first one
+		type= pv_broadcast_node_type();
+		for(node_for_setpoint= 0; node_for_setpoint < pv_max_nodes; node_for_setpoint++){
+			if(pv_nodes[node_for_setpoint].node_type != NoInverter)
+				break;
+		}
+	}
+	else if(node_index < pv_max_nodes){
+		type= pv_nodes[node_index].node_type;
+	}
+
+	if((type == NoInverter) || (node_for_setpoint >= pv_max_nodes))
+		return(transaction_timeout);
+
+	//Setpoint, sample time and plan are latched only when the first frame starts
+	if((frame_index == 0) && !(pv_variable_modbus & (pv_sync_enable_power_limit | pv_sync_power_limit | pv_sync_verify_power_limit))){
+		pv_global_setpoint= pv_nodes[node_for_setpoint].power_limit_setpoint;
+		pv_global_setpoint_sample_time= pv_nodes[node_for_setpoint].power_limit_sample_time;
+		pv_build_write_plan(type, pv_global_setpoint, (!broadcast && pv_setpoint_verify), &pv_write_plan);
+	}
+
+	if(frame_index >= pv_write_plan.frames)
+		return(transaction_timeout);
+
+	_pv_write_frame *frame= &pv_write_plan.frame[frame_index];
+
+	//Set the destination node address
+	if(broadcast){
+		pv_node.setSlaveAddr(ModbusMaster::ku8MBBroadcastAddress);
+		pv_variable_modbus|= pv_sync_broadcast;
+	}
+	else{
+		pv_node.setSlaveAddr(pv_nodes[node_index].node_addr);
+		pv_global_node_index= node_index; //Signaling the node that is communicating
+	}
+
+	//Read back only (0x03)
+	if(frame->function == pv_frame_read){
+		pv_variable_modbus|= pv_sync_verify_power_limit; //Signaling the variable that is being read
+		return(pv_node.readHoldingRegisters(pv_write_plan.readback.address, pv_write_plan.readback.quantity));
+	}
+
+	//Signaling the variable that is being written - only the power limit is acknowledged
+	pv_variable_modbus|= frame->setpoint ? pv_sync_power_limit : pv_sync_enable_power_limit;
+
+	for(uint8_t i= 0; i < frame->quantity; i++){
+		pv_node.setTransmitBuffer(i, frame->value[i]);
+	}
+
+	//Write and read back in one transaction (0x17)
+	if(frame->function == pv_frame_write_read){
+		pv_variable_modbus|= pv_sync_verify_power_limit;
+		return(pv_node.readWriteMultipleRegisters(pv_write_plan.readback.address, pv_write_plan.readback.quantity,
+				frame->address, frame->quantity));
+	}
+
+	//Non-blocking function - one register (0x06) or adjacent registers (0x10)
+	if(frame->quantity == 1)
+		return(pv_node.writeSingleRegister(frame->address, frame->value[0]));
+
+	return(pv_node.writeMultipleRegisters(frame->address, frame->quantity));
+}
+
+/*-----------------------------------------------------------------
+ * Verify the setpoint read back of @node_index from the response buffer
+ * ----------------------------------------------------------------*/
+void pv_verify_setpoint(uint8_t node_index){
+	_pv_modbus_node *node= &pv_nodes[node_index];
+	_pv_setpoint_readback *readback= &pv_write_plan.readback;
+
+	uint16_t limit= pv_node.getResponseBuffer(readback->limit);
+	bool enabled= (readback->enable == pv_readback_none) ||
+				  (pv_node.getResponseBuffer(readback->enable) == readback->enable_value);
+
+	//Active power read in the same transaction - low word first
+	if(readback->active_power != pv_readback_none){
+		uint32_t active_power= pv_node.getResponseBuffer(readback->active_power + 1);
+		active_power<<= 16;
+		active_power|= pv_node.getResponseBuffer(readback->active_power);
+		pv_store_active_power(node_index, active_power, pv_node.getResponseTime());
+	}
+
+	//Setpoint applied by the node
+	if(enabled && (limit == pv_global_setpoint)){
+		node->power_limit_acknowledged= limit;
+		node->power_limit_retries= 0;
+		pv_setpoint_failed_nodes&= ~((uint32_t)1 << node_index);
+		return;
+	}
+
+	//Setpoint not applied - write it again
+	pv_setpoint_verify_errors++;
+	node->power_limit_acknowledged= enabled ? limit : pv_power_limit_max;
+	if(node->power_limit_retries < pv_setpoint_verify_retries){
+		node->power_limit_retries++;
+		pv_setpoint_pending_nodes|= ((uint32_t)1 << node_index);
+	}
+	else{
+		//All retries used - node signaled as failed (failsafe)
+		pv_setpoint_failed_nodes|= ((uint32_t)1 << node_index);
+	}
+}
+
 /*------------------------------------------------------------------
  *Update node communication status
  *@sucess define if the last modbus transaction was successful
@@ -456,6 +1262,8 @@ void pv_update_communication_status(uint8_t node_index, bool sucess){
 			else{//Increment the error counter and check the new status
 				if(++pv_nodes[node_index].node_comm_error_counter == pv_max_comm_errors){
 					pv_nodes[node_index].node_communication_status= disconnected;
+					energy_gap(&pv_nodes[node_index].node_energy);
+					soe_record(soe_pv_comm, node_index, disconnected, micros());
 					pv_flag_sync|= pv_sync_comm_status;
 				}
 			}
@@ -464,10 +1272,64 @@ void pv_update_communication_status(uint8_t node_index, bool sucess){
 				if(sucess){//Decrement the error counter and set the new status
 					pv_nodes[node_index].node_comm_error_counter--;
 					pv_nodes[node_index].node_communication_status= timeout;
+					//Node may have restarted - limit must be written again
+					pv_nodes[node_index].power_limit_acknowledged= pv_power_limit_unknown;
 					pv_flag_sync|= pv_sync_comm_status;
+					soe_record(soe_pv_comm, node_index, timeout, micros());
 				}
 			break;
 	}
 }
 
+/*------------------------------------------------------------------
+ *Store the @active_power sample of @node_index received at @sample_time
+ *[ms] - energy integrated, new active power signaled on pv_flag_sync
+ *Used by the active power read and the setpoint read back
+ *----------------------------------------------------------------*/
+void pv_store_active_power(uint8_t node_index, uint32_t active_power, uint32_t sample_time){
+	volatile _pv_node_modbus_data *data= &pv_nodes[node_index].node_modbus_variables;
+
+	data->active_power= active_power;
+	data->active_power_time= sample_time;
+	data->sampled_variables|= pv_sync_active_power;
+
+	//Energy integration
+	int64_t energy= energy_integrate(&pv_nodes[node_index].node_energy,
+			pv_active_power_to_w(node_index, active_power), sample_time);
+	pv_energy_total+= energy;
+	load_energy_total+= energy;
+
+	//Indicate that there are new active power for some node
+	pv_flag_sync|= pv_sync_active_power;
+}
+
+/*------------------------------------------------------------------
+ *Convert the @active_power received from @node_index to W
+ *----------------------------------------------------------------*/
+int32_t pv_active_power_to_w(uint8_t node_index, uint32_t active_power){
+	switch (pv_nodes[node_index].node_type) {
+		case Sungrow:
+				return((int32_t)(((int64_t)active_power * Sungrow::active_power_w_mul) / Sungrow::active_power_w_div));
+			break;
+		default:
+				return(0);
+			break;
+	}
+}
+
+/*------------------------------------------------------------------
+ *Convert the @nominal_power received from @node_index to W
+ *----------------------------------------------------------------*/
+int32_t pv_nominal_power_to_w(uint8_t node_index, uint32_t nominal_power){
+	switch (pv_nodes[node_index].node_type) {
+		case Sungrow:
+				return((int32_t)(((int64_t)nominal_power * Sungrow::nominal_power_w_mul) / Sungrow::nominal_power_w_div));
+			break;
+		default:
+				return(0);
+			break;
+	}
+}
+
+
 #endif /* PV_MODBUS_H_ */
@@ -0,0 +1,149 @@
+/*
+ * ramp_limiter.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Ramp rate limiter - integer arithmetic only (no FPU)
+ *      No Arduino dependency, can be compiled on the host for tuning
+ */
+
+#ifndef RAMP_LIMITER_H_
+#define RAMP_LIMITER_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include <stdint.h>
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+/**
+ * Output is fixed point Q16 to keep the fraction of small steps
+ */
+static const uint8_t ramp_q= 16;
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+typedef struct{
+	//Tuning
+	int32_t rate_up;		//Maximum output increase [units per second] (0= no limit)
+	int32_t rate_down;		//Maximum output decrease [units per second] (0= no limit)
+
+	//State
+	int64_t output;			//Last output [Q16]
+	bool limited;			//Last output was limited
+}_ramp_limiter;
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the rates [units per second] and the output
+ * ----------------------------------------------------------------*/
+void ramp_init(_ramp_limiter *ramp, int32_t rate_up, int32_t rate_down, int32_t output);
+
+/*------------------------------------------------------------------
+ * Restart the ramp from @output (no limitation of this step)
+ * ----------------------------------------------------------------*/
+void ramp_reset(_ramp_limiter *ramp, int32_t output);
+
+/*------------------------------------------------------------------
+ * Maximum change at @rate [units per second] in @time_ms [Q16]
+ * ----------------------------------------------------------------*/
+int64_t ramp_step(int32_t rate, uint32_t time_ms);
+
+/*------------------------------------------------------------------
+ * Limiter step - called once per period of @period_ms
+ * @applied is the output actually in use by the plant, @latency_ms
+ * the time a new output takes to be applied: the output is kept within
+ * one latency and one period of ramp from @applied, so the ramp seen by
+ * the plant is the configured one even with a slow command path
+ * Return the new output
+ * ----------------------------------------------------------------*/
+int32_t ramp_update(_ramp_limiter *ramp, int32_t target, int32_t applied, uint32_t period_ms, uint32_t latency_ms);
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the rates [units per second] and the output
+ * ----------------------------------------------------------------*/
+void ramp_init(_ramp_limiter *ramp, int32_t rate_up, int32_t rate_down, int32_t output){
+	ramp->rate_up= rate_up;
+	ramp->rate_down= rate_down;
+
+	ramp_reset(ramp, output);
+}
+
+/*------------------------------------------------------------------
+ * Restart the ramp from @output (no limitation of this step)
+ * ----------------------------------------------------------------*/
+void ramp_reset(_ramp_limiter *ramp, int32_t output){
+	ramp->output= ((int64_t)output << ramp_q);
+	ramp->limited= false;
+}
+
+/*------------------------------------------------------------------
+ * Maximum change at @rate [units per second] in @time_ms [Q16]
+ * ----------------------------------------------------------------*/
+int64_t ramp_step(int32_t rate, uint32_t time_ms){
+	return((((int64_t)rate << ramp_q) * time_ms) / 1000);
+}
+
+/*------------------------------------------------------------------
+ * Limiter step - called once per period of @period_ms
+ * @applied is the output actually in use by the plant, @latency_ms
+ * the time a new output takes to be applied: the output is kept within
+ * one latency and one period of ramp from @applied, so the ramp seen by
+ * the plant is the configured one even with a slow command path
+ * Return the new output
+ * ----------------------------------------------------------------*/
+int32_t ramp_update(_ramp_limiter *ramp, int32_t target, int32_t applied, uint32_t period_ms, uint32_t latency_ms){
+	int64_t output= ((int64_t)target << ramp_q);
+	int64_t applied_q= ((int64_t)applied << ramp_q);
+
+	ramp->limited= false;
+
+	//Increase - one period of ramp from the last output, and never more than
+	//one latency plus one period ahead of the applied output
+	if((ramp->rate_up > 0) && (output > ramp->output)){
+		int64_t upper= ramp->output + ramp_step(ramp->rate_up, period_ms);
+		int64_t applied_upper= applied_q + ramp_step(ramp->rate_up, period_ms + latency_ms);
+
+		//Applied output behind - hold, never go back because of it
+		if(applied_upper < upper)
+			upper= (applied_upper > ramp->output) ? applied_upper : ramp->output;
+
+		if(output > upper){
+			output= upper;
+			ramp->limited= true;
+		}
+	}
+	//Decrease
+	else if((ramp->rate_down > 0) && (output < ramp->output)){
+		int64_t lower= ramp->output - ramp_step(ramp->rate_down, period_ms);
+		int64_t applied_lower= applied_q - ramp_step(ramp->rate_down, period_ms + latency_ms);
+
+		if(applied_lower > lower)
+			lower= (applied_lower < ramp->output) ? applied_lower : ramp->output;
+
+		if(output < lower){
+			output= lower;
+			ramp->limited= true;
+		}
+	}
+
+	ramp->output= output;
+
+	return((int32_t)(output >> ramp_q));
+}
+
+
+#endif /* RAMP_LIMITER_H_ */
@@ -0,0 +1,193 @@
+/*
+ * sequence_of_events.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Sequence of events recorder - timestamped digital input, breaker
+ *      and communication changes on a single producer / single consumer
+ *      ring buffer (no locks, no interrupts disabled)
+ *      Producers (input sampler, breakers, bus callbacks, protection) run
+ *      on the main loop context - one producer; the reader is the consumer
+ */
+
+#ifndef SEQUENCE_OF_EVENTS_H_
+#define SEQUENCE_OF_EVENTS_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include <Arduino.h>
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Event types
+static const uint8_t soe_di_change= 0x01;		//Digital input - source: input index, data: state
+static const uint8_t soe_breaker_change= 0x02;	//Circuit breaker - source: breaker, data: status
+static const uint8_t soe_genset_comm= 0x03;		//Genset node - source: node index, data: communication status
+static const uint8_t soe_pv_comm= 0x04;			//PV node - source: node index, data: communication status
+static const uint8_t soe_protection_trip= 0x05;	//Reverse power trip - data: 0
+
+/**
+ * Ring buffer size - power of 2, indexes wrap by mask
+ */
+static const uint16_t soe_buffer_size= 64;
+static const uint16_t soe_buffer_mask= soe_buffer_size - 1;
+
+//Maximum events printed on each debug dump (bounded serial time)
+static const uint8_t soe_dump_max_events= 8;
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+typedef struct{
+	uint32_t time;		//Event time [us]
+	uint8_t type;		//soe_* event type
+	uint8_t source;		//Input, breaker or node index
+	uint16_t data;		//New state
+}_soe_event;
+
+_soe_event soe_buffer[soe_buffer_size];
+
+//Free running indexes - head written only by the producer, tail only by the consumer
+volatile uint16_t soe_head;
+volatile uint16_t soe_tail;
+
+//Events lost with the buffer full (written only by the producer)
+volatile uint16_t soe_overflows;
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the recorder (empty buffer)
+ * ----------------------------------------------------------------*/
+void soe_init();
+
+/*------------------------------------------------------------------
+ * Record an event at @time [us] - producer side
+ * Return false if the buffer is full (event counted on soe_overflows)
+ * ----------------------------------------------------------------*/
+bool soe_record(uint8_t type, uint8_t source, uint16_t data, uint32_t time);
+
+/*------------------------------------------------------------------
+ * Number of events waiting to be read
+ * ----------------------------------------------------------------*/
+uint16_t soe_pending();
+
+/*------------------------------------------------------------------
+ * Read the oldest event to @event - consumer side
+ * Return false if there is no event
+ * ----------------------------------------------------------------*/
+bool soe_read(_soe_event *event);
+
+/*------------------------------------------------------------------
+ * Print the oldest events on the debug port - called from main loop
+ * ----------------------------------------------------------------*/
+void soe_dump();
+
+
+ /*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Initialize the recorder (empty buffer)
+ * ----------------------------------------------------------------*/
+void soe_init(){
+	soe_head= 0;
+	soe_tail= 0;
+	soe_overflows= 0;
+}
+
+/*------------------------------------------------------------------
+ * Record an event at @time [us] - producer side
+ * The slot is written before the head is published, so the consumer
+ * never reads an incomplete event. The producer never waits: with the
+ * buffer full the new event is dropped and counted
+ * Return false if the buffer is full (event counted on soe_overflows)
+ * ----------------------------------------------------------------*/
+bool soe_record(uint8_t type, uint8_t source, uint16_t data, uint32_t time){
+	uint16_t head= soe_head;
+
+	if((uint16_t)(head - soe_tail) >= soe_buffer_size){
+		soe_overflows++;
+		return(false);
+	}
+
+	_soe_event *event= &soe_buffer[head & soe_buffer_mask];
+	event->time= time;
+	event->type= type;
+	event->source= source;
+	event->data= data;
+
+	//Event stored before the new head (compiler barrier, single core)
+	__asm__ volatile("" ::: "memory");
+	soe_head= head + 1;
+
+	return(true);
+}
+
+/*------------------------------------------------------------------
+ * Number of events waiting to be read
+ * ----------------------------------------------------------------*/
+uint16_t soe_pending(){
+	return((uint16_t)(soe_head - soe_tail));
+}
+
+/*------------------------------------------------------------------
+ * Read the oldest event to @event - consumer side
+ * Return false if there is no event
+ * ----------------------------------------------------------------*/
+bool soe_read(_soe_event *event){
+	uint16_t tail= soe_tail;
+
+	if(tail == soe_head)
+		return(false);
+
+	//Head read before the event (compiler barrier, single core)
+	__asm__ volatile("" ::: "memory");
+	*event= soe_buffer[tail & soe_buffer_mask];
+
+	//Event copied before the slot is released to the producer
+	__asm__ volatile("" ::: "memory");
+	soe_tail= tail + 1;
+
+	return(true);
+}
+
+/*------------------------------------------------------------------
+ * Print the oldest events on the debug port - called from main loop
+ * Format: "SOE <time us> <type> <source> <data>"
+ * ----------------------------------------------------------------*/
+void soe_dump(){
+	static uint16_t overflows= 0;
+	_soe_event event;
+
+	for(uint8_t i= 0; i < soe_dump_max_events; i++){
+		if(!soe_read(&event))
+			break;
+
+		Serial.print("SOE ");
+		Serial.print(event.time);
+		Serial.print(" ");
+		Serial.print(event.type);
+		Serial.print(" ");
+		Serial.print(event.source);
+		Serial.print(" ");
+		Serial.println(event.data);
+	}
+
+	//Events lost since the last dump
+	if(soe_overflows != overflows){
+		overflows= soe_overflows;
+		Serial.print("SOE overflows ");
+		Serial.println(overflows);
+	}
+}
+
+
+#endif /* SEQUENCE_OF_EVENTS_H_ */
@@ -0,0 +1,135 @@
+/*
+ * ac_measurement_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      AC measurement accuracy - synthetic 12 bits ADC sine waves from 45 to
+ *      60Hz (amplitude, DC bias, noise) streamed through ac_sample() at the
+ *      per input ADC rate; frequency and RMS results are checked against the
+ *      exact values
+ *
+ *      Exit code 1 when an error is above its tolerance
+ */
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include <stdio.h>
+#include <math.h>
+#include "../src/ac_measurement.h"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Per input sample rate - about 50k samples/s shared by 4 inputs [samples/s]
+static const double test_sample_rate= 12345.6;
+
+//Signal length per case [s] - first results skipped: the first window is
+//computed on the default DC bias and the second starts on a crossing
+//detected with it
+static const double test_duration= 2.0;
+static const uint32_t test_skip_results= 2;
+
+//RMS tolerance [% of the exact value]
+static const double test_rms_tolerance= 0.5;
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+typedef struct{
+	double amplitude;		//Peak [ADC counts]
+	double dc;				//DC bias [ADC counts]
+	double noise;			//Uniform noise peak [ADC counts]
+	double tolerance;		//Frequency tolerance [mHz] - noise over the slope at the crossing
+}_test_signal;
+
+static const _test_signal test_signals[]= {
+	{1800, 2048, 0, 5},		//Near full scale
+	{1000, 2048, 8, 20},
+	{300, 2100, 8, 50},		//Small signal, DC bias off mid scale
+	{120, 1990, 4, 60},		//Close to the zero crossing hysteresis
+};
+
+static const double test_frequencies[]= {45.0, 47.5, 49.9, 50.0, 52.5, 55.0, 59.95, 60.0};
+
+//Noise generator state (deterministic)
+static uint32_t test_seed= 12345;
+
+
+/*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Uniform noise in [-1, 1]
+ * ----------------------------------------------------------------*/
+static double test_noise(){
+	test_seed= test_seed * 1664525 + 1013904223;
+	return(((double)(test_seed >> 8) / (double)(1 << 24)) * 2.0 - 1.0);
+}
+
+/*------------------------------------------------------------------
+ * Stream one signal - worst errors of the results after the DC bias settled
+ * Return false when no result was computed
+ * ----------------------------------------------------------------*/
+static bool test_run(double frequency, const _test_signal *signal, double *frequency_error, double *rms_error){
+	_ac_measurement ac;
+	ac_init(&ac, (uint32_t)(test_sample_rate * (1 << ac_q) + 0.5));
+
+	double rms= signal->amplitude / sqrt(2.0);
+	double phase= test_noise() * M_PI;
+	uint32_t samples= (uint32_t)(test_duration * test_sample_rate);
+	uint32_t results= 0;
+
+	*frequency_error= 0;
+	*rms_error= 0;
+
+	for(uint32_t i= 0; i < samples; i++){
+		double value= signal->dc + signal->amplitude * sin(2 * M_PI * frequency * i / test_sample_rate + phase) +
+					  signal->noise * test_noise();
+		int32_t sample= (int32_t)floor(value + 0.5);
+		if(sample < 0)
+			sample= 0;
+		if(sample > 4095)
+			sample= 4095;
+
+		if(!ac_sample(&ac, sample) || !ac.valid)
+			continue;
+		if(results++ < test_skip_results)
+			continue;
+
+		double frequency_diff= fabs((double)ac.frequency - frequency * 1000);
+		double rms_diff= fabs((double)ac.rms / (1 << ac_q) - rms) * 100 / rms;
+		if(frequency_diff > *frequency_error)
+			*frequency_error= frequency_diff;
+		if(rms_diff > *rms_error)
+			*rms_error= rms_diff;
+	}
+
+	return(results > test_skip_results);
+}
+
+int main(){
+	bool passed= true;
+
+	printf("Sample rate %.1f samples/s, RMS tolerance %.1f%%\n\n", test_sample_rate, test_rms_tolerance);
+	printf("%9s %6s %6s %6s %14s %6s %10s\n", "freq [Hz]", "peak", "dc", "noise", "freq err [mHz]", "tol", "rms err [%]");
+
+	for(size_t s= 0; s < sizeof(test_signals) / sizeof(test_signals[0]); s++){
+		for(size_t f= 0; f < sizeof(test_frequencies) / sizeof(test_frequencies[0]); f++){
+			double frequency_error, rms_error;
+			bool ok= test_run(test_frequencies[f], &test_signals[s], &frequency_error, &rms_error);
+			ok= ok && (frequency_error <= test_signals[s].tolerance) && (rms_error <= test_rms_tolerance);
+			passed&= ok;
+
+			printf("%9.2f %6.0f %6.0f %6.0f %14.1f %6.0f %10.3f %s\n", test_frequencies[f], test_signals[s].amplitude,
+				   test_signals[s].dc, test_signals[s].noise, frequency_error, test_signals[s].tolerance, rms_error,
+				   ok ? "" : "FAIL");
+		}
+	}
+
+	printf("\n%s\n", passed ? "PASS" : "FAIL");
+	return(passed ? 0 : 1);
+}
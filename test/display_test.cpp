@@ -0,0 +1,215 @@
+/*
+ * display_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Display refresh - manage_display() against a fake panel port: a
+ *      bounded transmit buffer drained at the panel baud rate each 1ms tick
+ *      and a 20x4 panel decoding the cursor commands
+ *
+ *      Checks: a full frame is on the panel within a bounded number of
+ *      ticks, a 5 characters change costs 9 bytes (cursor and characters),
+ *      nothing is sent without room in the transmit buffer
+ *
+ *      Exit code 1 when a check fails
+ */
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include "display.h"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Transmit buffer of the fake port [bytes]
+static const int test_tx_buffer= 16;
+
+//Bytes drained by the UART each second - display_baud_rate, 10 bits per byte
+static const uint32_t test_tx_rate= display_baud_rate / 10;
+
+//Full frame - cursor command and all cells of each row [bytes]
+static const uint32_t test_frame_bytes= display_rows * (display_cursor_cmd_len + display_cols);
+
+//Full frame ticks bound - drain rate plus one tick per row for a cursor
+//command waiting for room
+static const uint32_t test_frame_ticks= (test_frame_bytes * 1000 + test_tx_rate - 1) / test_tx_rate + display_rows;
+
+//Cost of a 5 characters change away from the cursor [bytes]
+static const uint32_t test_change_bytes= display_cursor_cmd_len + 5;
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+/**
+ * Fake panel port
+ *-->availableForWrite() is the free room of the transmit buffer
+ *-->Bytes are decoded as the panel does (clear, cursor, characters)
+ */
+class TestPanel: public Stream{
+public:
+	int pending;							//Bytes in the transmit buffer
+	int room_limit;							//Room reported at most (test of a full buffer)
+	uint32_t received;						//Bytes written
+	char screen[display_rows][display_cols];
+
+	TestPanel(): pending(0), room_limit(test_tx_buffer), received(0), drained(0), command(0), cursor_col(0), row(0), col(0){
+		memset(screen, '?', sizeof(screen));
+	}
+
+	int availableForWrite(){
+		int room= test_tx_buffer - pending;
+		return((room < room_limit) ? room : room_limit);
+	}
+
+	size_t write(uint8_t value){
+		pending++;
+		received++;
+		decode(value);
+		return(1);
+	}
+
+	//One 1ms tick of the UART
+	void tick(){
+		drained+= test_tx_rate;
+		int bytes= drained / 1000;
+		drained%= 1000;
+		pending= (pending > bytes) ? (pending - bytes) : 0;
+	}
+
+private:
+	uint32_t drained;						//Bytes drained [0.001 byte]
+	uint8_t command;						//Command bytes received (0= characters)
+	uint8_t cursor_col;
+	uint8_t row;
+	uint8_t col;
+
+	void decode(uint8_t value){
+		if(command == 0){
+			if(value == display_cmd_prefix){
+				command= 1;
+				return;
+			}
+			if((row < display_rows) && (col < display_cols))
+				screen[row][col]= (char)value;
+			col++;
+			return;
+		}
+
+		if(command == 1){
+			if(value == display_cmd_clear){
+				memset(screen, ' ', sizeof(screen));
+				row= col= 0;
+				command= 0;
+				return;
+			}
+			command= 2;
+			return;
+		}
+
+		if(command == 2){
+			cursor_col= value - 1;
+			command= 3;
+			return;
+		}
+
+		col= cursor_col;
+		row= value - 1;
+		command= 0;
+	}
+};
+
+
+/*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Print a check result - Return true when @value <= @bound
+ * ----------------------------------------------------------------*/
+static bool test_check(const char *name, uint32_t value, uint32_t bound){
+	bool ok= (value <= bound);
+	printf("  %-40s %6u <= %6u %s\n", name, value, bound, ok ? "ok" : "FAIL");
+	return(ok);
+}
+
+/*------------------------------------------------------------------
+ * Run manage_display() each tick until the frame is on the panel
+ * Return the ticks taken (@limit when not updated)
+ * ----------------------------------------------------------------*/
+static uint32_t test_refresh(TestPanel *panel, uint32_t limit){
+	uint32_t ticks= 0;
+	while(!display_updated() && (ticks < limit)){
+		panel->tick();
+		manage_display();
+		ticks++;
+	}
+	return(ticks);
+}
+
+/*------------------------------------------------------------------
+ * Panel shows the frame buffer
+ * ----------------------------------------------------------------*/
+static bool test_panel_matches(TestPanel *panel){
+	return(memcmp(panel->screen, display_frame, sizeof(display_frame)) == 0);
+}
+
+int main(){
+	bool passed= true;
+	TestPanel panel;
+
+	printf("Panel %ux%u, transmit buffer %d bytes, drain %u bytes/s, %u bytes per tick\n\n",
+		   display_cols, display_rows, test_tx_buffer, test_tx_rate, display_bytes_per_tick);
+
+	//Full frame - every cell changed
+	init_display(&panel);
+	for(uint8_t row= 0; row < display_rows; row++){
+		char text[display_cols + 1];
+		for(uint8_t col= 0; col < display_cols; col++)
+			text[col]= 'A' + ((row * display_cols + col) % 26);
+		text[display_cols]= '\0';
+		display_print(row, 0, text);
+	}
+	uint32_t ticks= test_refresh(&panel, 10 * test_frame_ticks);
+	printf("Full frame\n");
+	passed&= test_check("ticks", ticks, test_frame_ticks);
+	passed&= test_check("bytes", display_bytes_sent, test_frame_bytes);
+	passed&= test_check("panel differs from the frame", !test_panel_matches(&panel), 0);
+
+	//Small change away from the cursor - one cursor command and the characters
+	test_refresh(&panel, 1000);
+	uint32_t sent= panel.received;
+	display_print(2, 7, "12345");
+	test_refresh(&panel, 1000);
+	printf("5 characters change\n");
+	passed&= test_check("bytes", panel.received - sent, test_change_bytes);
+	passed&= test_check("bytes (at least)", test_change_bytes, panel.received - sent);
+	passed&= test_check("panel differs from the frame", !test_panel_matches(&panel), 0);
+
+	//No room - nothing sent, the frame stays pending
+	printf("No room\n");
+	for(int room= 0; room <= display_cursor_cmd_len; room++){
+		panel.room_limit= room;
+		sent= panel.received;
+		display_print(0, 0, (room & 1) ? "odd " : "even");
+		for(uint8_t i= 0; i < 10; i++){
+			panel.tick();
+			manage_display();
+		}
+		char name[48];
+		snprintf(name, sizeof(name), "bytes with room %d", room);
+		passed&= test_check(name, panel.received - sent, 0);
+		passed&= test_check("frame updated", display_updated(), 0);
+	}
+	panel.room_limit= test_tx_buffer;
+	test_refresh(&panel, 1000);
+	passed&= test_check("panel differs once room is back", !test_panel_matches(&panel), 0);
+
+	printf("\n%s\n", passed ? "PASS" : "FAIL");
+	return(passed ? 0 : 1);
+}
@@ -0,0 +1,146 @@
+/*
+ * Arduino.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Host shim of the Arduino Due API used by the firmware - virtual
+ *      clock, silent debug ports, simulated RS485 buses (rs485_bus.h) and
+ *      the SAM3X registers touched by the I/O modules as plain memory
+ */
+
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 2
+#define FALLING 3
+#define RISING 4
+#define LED_BUILTIN 13
+#define A0 54
+#define A1 55
+#define A2 56
+#define A3 57
+
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) (bitvalue ? bitSet(value, bit) : bitClear(value, bit))
+#define digitalPinToInterrupt(p) (p)
+
+static inline uint16_t word(uint16_t w){return(w);}
+static inline uint16_t word(uint8_t h, uint8_t l){return((uint16_t)((h << 8) | l));}
+
+//Core clock - DWT cycle counter follows the virtual clock
+#define SystemCoreClock 84000000u
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+//Virtual clock [us] - advanced by the simulation and the bus transfers
+extern uint64_t host_time_us;
+
+//Serial port - debug and display ports discard the output
+class Stream{
+public:
+	virtual ~Stream(){}
+	virtual int available(){return(0);}
+	virtual int read(){return(-1);}
+	virtual size_t write(uint8_t){return(1);}
+	virtual void flush(){}
+	virtual int availableForWrite(){return(64);}
+	size_t write(const uint8_t *, size_t n){return(n);}
+	void begin(unsigned long){}
+	size_t print(const char *){return(0);}
+	size_t print(long, int= 10){return(0);}
+	size_t print(unsigned long, int= 10){return(0);}
+	size_t print(int, int= 10){return(0);}
+	size_t print(unsigned, int= 10){return(0);}
+	size_t println(const char *){return(0);}
+	size_t println(long, int= 10){return(0);}
+	size_t println(unsigned long, int= 10){return(0);}
+	size_t println(int, int= 10){return(0);}
+	size_t println(unsigned, int= 10){return(0);}
+	size_t println(){return(0);}
+};
+
+#include "rs485_bus.h"
+
+extern Stream Serial, Serial3;
+extern Rs485Bus Serial1, Serial2;
+
+//SAM3X peripherals - registers as memory
+struct Pio{ volatile uint32_t PIO_PDSR, PIO_SODR, PIO_CODR, PIO_ODSR, PIO_OWER, PIO_OWDR; };
+struct PinDescription{ Pio *pPort; uint32_t ulPin; uint32_t ulADCChannelNumber; };
+//PDC pointers hold the buffer addresses - pointer size on the host
+struct Adc{ volatile uint32_t ADC_CR, ADC_MR, ADC_EMR, ADC_CHER, ADC_CHDR, ADC_IER, ADC_IDR, ADC_ISR;
+			volatile uintptr_t ADC_RPR; volatile uint32_t ADC_RCR;
+			volatile uintptr_t ADC_RNPR; volatile uint32_t ADC_RNCR, ADC_PTCR; };
+struct DWT_Type{ volatile uint32_t CTRL; volatile uint32_t CYCCNT; };
+struct CoreDebug_Type{ volatile uint32_t DEMCR; };
+
+extern PinDescription g_APinDescription[];
+extern Pio host_pio;		//All pins on one port - inputs released (high)
+extern Adc host_adc;
+extern CoreDebug_Type host_core_debug;
+
+#define ADC (&host_adc)
+#define ADC_IRQn 37
+#define ADC_EMR_TAG (1u << 24)
+#define ADC_MR_PRESCAL_Msk (0xffu << 8)
+#define ADC_MR_PRESCAL(v) ((0xffu << 8) & ((v) << 8))
+#define ADC_MR_FREERUN_ON (1u << 7)
+#define ADC_IER_ENDRX (1u << 27)
+#define ADC_ISR_ENDRX (1u << 27)
+#define ADC_CR_START 2u
+#define PERIPH_PTCR_RXTEN 1u
+#define PERIPH_PTCR_RXTDIS 2u
+#define PERIPH_PTCR_TXTDIS 0x200u
+
+#define DWT (host_dwt())
+#define CoreDebug (&host_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk 1u
+#define CoreDebug_DEMCR_TRCENA_Msk (1u << 24)
+
+
+/*------------------------------------------------------------------
+ * 					PROTOTYPES
+ * ----------------------------------------------------------------*/
+unsigned long millis();
+unsigned long micros();
+void delayMicroseconds(unsigned int us);
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t value);
+int digitalRead(uint32_t pin);
+void attachInterrupt(uint32_t pin, void (*callback)(), uint32_t mode);
+void analogReadResolution(int bits);
+void watchdogEnable(uint32_t timeout);
+void watchdogReset();
+static inline void NVIC_EnableIRQ(int){}
+
+//DWT registers - cycle counter updated from the virtual clock
+DWT_Type *host_dwt();
+
+
+#endif /* HOST_ARDUINO_H_ */
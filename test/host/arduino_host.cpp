@@ -0,0 +1,85 @@
+/*
+ * arduino_host.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Host shim of the Arduino Due API - definitions (Arduino.h)
+ */
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include "Arduino.h"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+uint64_t host_time_us= 0;
+
+Stream Serial, Serial3;
+Rs485Bus Serial1, Serial2;
+
+Pio host_pio;
+Adc host_adc;
+CoreDebug_Type host_core_debug;
+DWT_Type host_dwt_registers;
+
+//Pins on one port, line = pin % 32; A0..A3 on ADC channels 7..4 (Due)
+PinDescription g_APinDescription[80];
+
+static uint8_t host_pins[80];
+
+
+/*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+//Pin table and released inputs before any firmware initialization
+static struct HostBoard{
+	HostBoard(){
+		for(uint8_t pin= 0; pin < 80; pin++){
+			g_APinDescription[pin].pPort= &host_pio;
+			g_APinDescription[pin].ulPin= (uint32_t)1 << (pin % 32);
+			g_APinDescription[pin].ulADCChannelNumber= ((pin >= A0) && (pin <= A3)) ? (uint32_t)(61 - pin) : 0;
+			host_pins[pin]= HIGH;
+		}
+		host_pio.PIO_PDSR= 0xFFFFFFFF;
+	}
+}host_board;
+
+unsigned long millis(){
+	return((unsigned long)(host_time_us / 1000));
+}
+
+unsigned long micros(){
+	return((unsigned long)host_time_us);
+}
+
+void delayMicroseconds(unsigned int us){
+	host_time_us+= us;
+}
+
+void pinMode(uint32_t, uint32_t){}
+
+void digitalWrite(uint32_t pin, uint32_t value){
+	if(pin < 80)
+		host_pins[pin]= value ? HIGH : LOW;
+}
+
+int digitalRead(uint32_t pin){
+	return((pin < 80) ? host_pins[pin] : HIGH);
+}
+
+void attachInterrupt(uint32_t, void (*)(), uint32_t){}
+
+void analogReadResolution(int){}
+
+void watchdogEnable(uint32_t){}
+
+void watchdogReset(){}
+
+DWT_Type *host_dwt(){
+	host_dwt_registers.CYCCNT= (uint32_t)(host_time_us * (SystemCoreClock / 1000000));
+	return(&host_dwt_registers);
+}
@@ -0,0 +1,172 @@
+/*
+ * rs485_bus.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Simulated RS485 bus with in-memory Modbus RTU slaves - the frames
+ *      written by ModbusMaster are served on flush(); transfer and turnaround
+ *      times advance the virtual clock like the real line
+ */
+
+#ifndef HOST_RS485_BUS_H_
+#define HOST_RS485_BUS_H_
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include <map>
+#include <vector>
+#include <deque>
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Character time at 115200 baud, 10 bits [us]
+static const uint32_t rs485_char_time= 87;
+
+//Slave turnaround - request received to answer start [us]
+static const uint32_t rs485_turnaround_time= 2000;
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+//Slave register banks - input (0x04) and holding (0x03/0x06/0x10/0x17)
+struct Rs485Slave{
+	std::map<uint16_t, uint16_t> input;
+	std::map<uint16_t, uint16_t> holding;
+	bool present;
+
+	Rs485Slave(): present(true){}
+};
+
+class Rs485Bus: public Stream{
+public:
+	std::map<uint8_t, Rs485Slave> slaves;	//By Modbus address
+
+	//Statistics
+	uint32_t frames;						//Requests sent by the master
+	uint32_t broadcasts;					//Requests to address 0
+	uint32_t function_count[0x20];			//Requests by function code
+
+	Rs485Bus(): frames(0), broadcasts(0), ready_time(0){
+		memset(function_count, 0, sizeof(function_count));
+	}
+
+	virtual int available(){
+		return((host_time_us >= ready_time) ? (int)response.size() : 0);
+	}
+
+	virtual int read(){
+		if((host_time_us < ready_time) || response.empty())
+			return(-1);
+		int value= response.front();
+		response.pop_front();
+		return(value);
+	}
+
+	virtual size_t write(uint8_t value){
+		request.push_back(value);
+		return(1);
+	}
+
+	//Frame sent - line time elapsed, answer scheduled after the turnaround
+	virtual void flush(){
+		host_time_us+= request.size() * rs485_char_time;
+		serve();
+		request.clear();
+	}
+
+private:
+	std::vector<uint8_t> request;
+	std::deque<uint8_t> response;
+	uint64_t ready_time;
+
+	static uint16_t crc16(const uint8_t *data, size_t size){
+		uint16_t crc= 0xFFFF;
+		for(size_t i= 0; i < size; i++){
+			crc^= data[i];
+			for(uint8_t bit= 0; bit < 8; bit++)
+				crc= (crc & 1) ? ((crc >> 1) ^ 0xA001) : (crc >> 1);
+		}
+		return(crc);
+	}
+
+	uint16_t get16(size_t offset){
+		return((uint16_t)((request[offset] << 8) | request[offset + 1]));
+	}
+
+	void reply(std::vector<uint8_t> frame){
+		uint16_t crc= crc16(frame.data(), frame.size());
+		frame.push_back(crc & 0xFF);
+		frame.push_back(crc >> 8);
+		response.insert(response.end(), frame.begin(), frame.end());
+		ready_time= host_time_us + rs485_turnaround_time + frame.size() * rs485_char_time;
+	}
+
+	void reply_registers(uint8_t address, uint8_t function, std::map<uint16_t, uint16_t> &bank,
+						 uint16_t first, uint16_t quantity, std::map<uint16_t, uint16_t> *fallback){
+		std::vector<uint8_t> frame;
+		frame.push_back(address);
+		frame.push_back(function);
+		frame.push_back((uint8_t)(2 * quantity));
+		for(uint16_t i= 0; i < quantity; i++){
+			uint16_t reg= first + i;
+			uint16_t value= bank.count(reg) ? bank[reg] : (fallback ? (*fallback)[reg] : 0);
+			frame.push_back(value >> 8);
+			frame.push_back(value & 0xFF);
+		}
+		reply(frame);
+	}
+
+	//Answer the request - broadcast (address 0) is applied to all slaves without answer
+	void serve(){
+		if(request.size() < 4)
+			return;
+
+		uint8_t address= request[0];
+		uint8_t function= request[1];
+		frames++;
+		function_count[function & 0x1F]++;
+		if(address == 0)
+			broadcasts++;
+
+		for(std::map<uint8_t, Rs485Slave>::iterator it= slaves.begin(); it != slaves.end(); ++it){
+			Rs485Slave &slave= it->second;
+			if(!slave.present || ((address != 0) && (address != it->first)))
+				continue;
+
+			std::vector<uint8_t> echo(request.begin(), request.begin() + 6);
+			switch(function){
+				case 0x03:
+				case 0x04:
+					if(address)
+						reply_registers(address, function, (function == 0x04) ? slave.input : slave.holding,
+										get16(2), get16(4), NULL);
+					break;
+				case 0x06:
+					slave.holding[get16(2)]= get16(4);
+					if(address)
+						reply(echo);
+					break;
+				case 0x10:
+					for(uint16_t i= 0; i < get16(4); i++)
+						slave.holding[get16(2) + i]= get16(7 + 2 * i);
+					if(address)
+						reply(echo);
+					break;
+				case 0x17:
+					for(uint16_t i= 0; i < get16(8); i++)
+						slave.holding[get16(6) + i]= get16(11 + 2 * i);
+					if(address)
+						reply_registers(address, function, slave.holding, get16(2), get16(4), &slave.input);
+					break;
+			}
+		}
+	}
+};
+
+
+#endif /* HOST_RS485_BUS_H_ */
@@ -0,0 +1,346 @@
+/*
+ * pi_bench.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Curtailment PI bench - the whole firmware (main.cpp, so the real
+ *      manage_curtailment, ramp and dispatcher) on a virtual clock against
+ *      simulated Sungrow inverters and Sices controllers in island, one
+ *      load or irradiance step per case. The bus voltage is fed to the ADC
+ *      DMA buffers at the droop frequency of the gensets
+ *
+ *      Usage: pi_bench [kp ki [kff [droop]]] - gains in Q16, droop in 0.1%,
+ *      default the curtailment ones
+ *      The cases run without the bus frequency, then with the droop
+ *
+ *      Report for each step: genset power deviation from its final value
+ *      (peak, overshoot past it), deepest undershoot below the minimum load
+ *      and settling time
+ *      Exit code 1 when a step is not settled at the end of the case or the
+ *      bus frequency was not measured
+ */
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../src/main.cpp"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Plant - nodes and nominal powers
+static const uint8_t bench_pv_nodes= 4;
+static const uint16_t bench_pv_nominal_kw= 100;
+static const uint8_t bench_genset_nodes= 2;
+static const uint16_t bench_genset_nominal_kw= 250;
+
+//Dynamics [s]
+static const double bench_pv_tau= 0.5;			//Inverter power response
+static const double bench_genset_tau= 0.2;		//Genset controller power measurement
+
+//Bus - genset governor droop (frequency at half load), waveform on the
+//bus voltage input [ADC counts]
+static const double bench_droop= 0.04;
+static const double bench_frequency= 50.0;
+static const double bench_ac_peak= 1500;
+static const double bench_ac_dc= 2048;
+
+//ADC samples per second of all the inputs (ai_adc_prescaler)
+static const double bench_adc_rate= 50000;
+
+//Virtual clock - loop iteration [us] and plant integration step [s]
+static const uint32_t bench_loop_time= 50;
+static const double bench_plant_period= 0.01;
+
+//Case timing [s] - settle on the conditions before the step, then measure
+static const double bench_settle= 20.0;
+static const double bench_measure= 40.0;
+
+//Settling band [0.1% of genset nominal power]
+static const double bench_settling_band= 20;	//2.0%
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+//Step case - load and PV available power before and after the step [kW]
+typedef struct{
+	const char *name;
+	double load_before;
+	double load_after;
+	double pv_available_before;
+	double pv_available_after;
+}_bench_case;
+
+static const _bench_case bench_cases[]= {
+	{"load drop 400->250 kW", 400, 250, 350, 350},
+	{"load rise 250->400 kW", 250, 400, 350, 350},
+	{"PV rise 150->350 kW", 400, 400, 150, 350},
+	{"PV drop 350->150 kW", 400, 400, 350, 150},
+};
+
+typedef struct{
+	double final;			//Genset power expected at the end [W]
+	double peak;			//Largest deviation from the final value [W]
+	double overshoot;		//Largest deviation past the final value, opposite to the first one [W]
+	double undershoot;		//Deepest genset power below the minimum load [W]
+	double settling;		//Step to last time out of the settling band [s]
+	bool settled;			//Within the band at the end of the case
+}_bench_result;
+
+//Plant state [W]
+double bench_pv_power[bench_pv_nodes];
+double bench_genset_measured;
+
+//Bus frequency [Hz], waveform phase [rad] and end of the DMA buffer being filled [s]
+double bench_bus_frequency;
+double bench_ac_phase;
+double bench_adc_time;
+
+//Bus frequency measured by the firmware [mHz]
+uint32_t bench_frequency_min;
+uint32_t bench_frequency_max;
+
+
+/*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+//Register constants are class members declared only (no definition) - the
+//unary + passes them by value to the std::map and comparison operators
+
+/*------------------------------------------------------------------
+ * Write a 32 bits value on two input registers (low word first)
+ * ----------------------------------------------------------------*/
+void bench_set_input32(Rs485Slave *slave, uint16_t address, uint32_t value){
+	slave->input[address]= value & 0xFFFF;
+	slave->input[address + 1]= value >> 16;
+}
+
+/*------------------------------------------------------------------
+ * Slaves configuration - nominal powers and breakers closed (island)
+ * ----------------------------------------------------------------*/
+void bench_plant_init(){
+	for(uint8_t i= 0; i < bench_pv_nodes; i++){
+		Rs485Slave *slave= &Serial1.slaves[i + 1];
+		slave->input[+Sungrow::nominal_power]= bench_pv_nominal_kw * 10;	//0.1 kW
+		slave->holding[+Sungrow::enable_power_limit]= +Sungrow::enable_power_limit_off;
+		slave->holding[+Sungrow::power_limit_percent]= pv_power_limit_max;
+		bench_pv_power[i]= 0;
+	}
+
+	for(uint8_t i= 0; i < bench_genset_nodes; i++){
+		Rs485Slave *slave= &Serial2.slaves[i + 1];
+		slave->input[+Sices::nominal_power]= bench_genset_nominal_kw;		//kW
+		slave->input[+Sices::gcb_status]= +Sices::gcb_status_mask;			//GCB closed, MCB opened: island
+	}
+
+	bench_genset_measured= 0;
+	bench_bus_frequency= bench_frequency;
+	bench_ac_phase= 0;
+	bench_adc_time= 0;
+}
+
+/*------------------------------------------------------------------
+ * ADC DMA buffers filled up to @time [s] - samples of the inputs in scan
+ * order, tagged with the channel, bus voltage on ai_ac_input
+ * ----------------------------------------------------------------*/
+void bench_adc_step(double time){
+	double sample_time= ai_inputs_nr / bench_adc_rate;
+
+	while(time >= (bench_adc_time + ai_buffer_size / bench_adc_rate)){
+		bench_adc_time+= ai_buffer_size / bench_adc_rate;
+
+		uint16_t *buffer= ai_dma_buffer[ai_dma_active];
+		for(uint16_t s= 0; s < ai_buffer_size; s++){
+			uint8_t input= s % ai_inputs_nr;
+			uint16_t value= (uint16_t)bench_ac_dc;
+			if(input == ai_ac_input){
+				value= (uint16_t)(bench_ac_dc + bench_ac_peak * sin(bench_ac_phase) + 0.5);
+				bench_ac_phase+= 2 * M_PI * bench_bus_frequency * sample_time;
+			}
+			buffer[s]= (uint16_t)(g_APinDescription[ai_pins[input]].ulADCChannelNumber << ai_sample_tag_shift) | value;
+		}
+		bench_ac_phase= fmod(bench_ac_phase, 2 * M_PI);
+
+		ADC->ADC_ISR= ADC_ISR_ENDRX;
+		ADC_Handler();
+	}
+}
+
+/*------------------------------------------------------------------
+ * Plant step of @dt [s] with @load and PV @available power [W]
+ * Return the genset power [W]
+ * ----------------------------------------------------------------*/
+double bench_plant_step(double load, double available, double dt){
+	double pv_total= 0;
+
+	for(uint8_t i= 0; i < bench_pv_nodes; i++){
+		Rs485Slave *slave= &Serial1.slaves[i + 1];
+		double target= available / bench_pv_nodes;
+
+		if(slave->holding[+Sungrow::enable_power_limit] == +Sungrow::enable_power_limit_on){
+			double limit= slave->holding[+Sungrow::power_limit_percent] * bench_pv_nominal_kw;
+			if(limit < target)
+				target= limit;
+		}
+
+		bench_pv_power[i]+= (target - bench_pv_power[i]) * (dt / bench_pv_tau);
+		pv_total+= bench_pv_power[i];
+		bench_set_input32(slave, +Sungrow::active_power, (uint32_t)bench_pv_power[i]);
+	}
+
+	//Island balance - gensets supply the rest, frequency on the droop line
+	double genset_power= load - pv_total;
+	double genset_nominal= (double)bench_genset_nodes * bench_genset_nominal_kw * 1000;
+	bench_genset_measured+= (genset_power - bench_genset_measured) * (dt / bench_genset_tau);
+	bench_bus_frequency= bench_frequency * (1 + bench_droop * (0.5 - genset_power / genset_nominal));
+
+	int32_t raw= (int32_t)((bench_genset_measured / bench_genset_nodes) * Sices::active_power_w_div / Sices::active_power_w_mul);
+	for(uint8_t i= 0; i < bench_genset_nodes; i++)
+		bench_set_input32(&Serial2.slaves[i + 1], +Sices::active_power, (uint32_t)raw);
+
+	return(genset_power);
+}
+
+/*------------------------------------------------------------------
+ * Run one step case on the firmware, from the current virtual time
+ * ----------------------------------------------------------------*/
+_bench_result bench_run(const _bench_case *step){
+	_bench_result result= {0, 0, 0, 0, 0, true};
+
+	double genset_nominal= (double)bench_genset_nodes * bench_genset_nominal_kw * 1000;
+	double min_load= genset_nominal * curtailment_min_load / 1000;
+	double band= genset_nominal * bench_settling_band / 1000;
+
+	//Final value - PV takes the load above the minimum load, up to its available power
+	double load_after= step->load_after * 1000;
+	result.final= load_after - step->pv_available_after * 1000;
+	if(result.final < min_load)
+		result.final= (load_after < min_load) ? load_after : min_load;
+
+	double start= host_time_us / 1e6;
+	double step_time= start + bench_settle;
+	double end= step_time + bench_measure;
+	double plant_time= start;
+	double first_sign= 0;
+
+	while(host_time_us < (uint64_t)(end * 1e6)){
+		loop();
+		host_time_us+= bench_loop_time;
+
+		double time= host_time_us / 1e6;
+		bench_adc_step(time);
+		if(ai_ac.valid){
+			if(ai_ac.frequency < bench_frequency_min)
+				bench_frequency_min= ai_ac.frequency;
+			if(ai_ac.frequency > bench_frequency_max)
+				bench_frequency_max= ai_ac.frequency;
+		}
+
+		if((time - plant_time) < bench_plant_period)
+			continue;
+		double dt= time - plant_time;
+		plant_time= time;
+
+		bool after= (time >= step_time);
+		double load= (after ? step->load_after : step->load_before) * 1000;
+		double available= (after ? step->pv_available_after : step->pv_available_before) * 1000;
+		double genset_power= bench_plant_step(load, available, dt);
+
+		if(!after)
+			continue;
+
+		//Step response around the final value - overshoot on the side opposite
+		//to the first deviation out of the band
+		double deviation= genset_power - result.final;
+		if((first_sign == 0) && (fabs(deviation) > band))
+			first_sign= (deviation > 0) ? 1 : -1;
+		if(fabs(deviation) > result.peak)
+			result.peak= fabs(deviation);
+		if((-first_sign * deviation) > result.overshoot)
+			result.overshoot= -first_sign * deviation;
+
+		if((min_load - genset_power) > result.undershoot)
+			result.undershoot= min_load - genset_power;
+
+		if(fabs(deviation) > band)
+			result.settling= time - step_time;
+	}
+
+	result.settled= (result.settling < (bench_measure - 1.0));
+	return(result);
+}
+
+/*------------------------------------------------------------------
+ * Run all the cases with the genset @droop [0.1%] configured
+ * Return true if all the steps settled
+ * ----------------------------------------------------------------*/
+bool bench_run_cases(uint16_t droop){
+	bool settled= true;
+
+	curtailment_set_droop(droop);
+	bench_frequency_min= UINT32_MAX;
+	bench_frequency_max= 0;
+
+	if(droop)
+		printf("Bus frequency used - droop %.1f%%\n", droop / 10.0);
+	else
+		printf("Bus frequency not used\n");
+	printf("%-24s %10s %10s %10s %12s %10s\n", "step", "final [kW]", "peak", "overshoot", "under min", "settling");
+
+	for(size_t i= 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++){
+		_bench_result result= bench_run(&bench_cases[i]);
+		printf("%-24s %10.1f %10.1f %10.1f %12.1f ", bench_cases[i].name, result.final / 1000,
+			   result.peak / 1000, result.overshoot / 1000, result.undershoot / 1000);
+		if(result.settled)
+			printf("%8.2f s\n", result.settling);
+		else
+			printf("%10s\n", "no");
+		settled&= result.settled;
+	}
+
+	//AC measurement on the bus voltage input - the frequency path had values
+	bool measured= (bench_frequency_max != 0);
+	if(measured)
+		printf("Bus frequency measured %.3f to %.3f Hz\n\n", bench_frequency_min / 1000.0, bench_frequency_max / 1000.0);
+	else
+		printf("Bus frequency not measured\n\n");
+
+	return(settled && measured);
+}
+
+int main(int argc, char **argv){
+	int32_t kp= (argc > 2) ? atoi(argv[1]) : curtailment_kp_default;
+	int32_t ki= (argc > 2) ? atoi(argv[2]) : curtailment_ki_default;
+	int32_t kff= (argc > 3) ? atoi(argv[3]) : curtailment_kff_default;
+	uint16_t droop= (argc > 4) ? atoi(argv[4]) : curtailment_droop_default;
+	bool passed= true;
+
+	bench_plant_init();
+
+	setup();
+	//Only the simulated nodes are configured
+	for(uint8_t i= bench_pv_nodes; i < pv_max_nodes; i++)
+		pv_set_node_type(i, NoInverter);
+	for(uint8_t i= bench_genset_nodes; i < genset_max_nodes; i++)
+		genset_set_node_type(i, NoGenset);
+	curtailment_set_gains(kp, ki, kff);
+
+	printf("Curtailment PI - kp %.3f ki %.3f kff %.3f (Q16 %d %d %d), rate max %.1f%%/period, ramp up %u down %u kW/s\n",
+		   (double)kp / pi_one, (double)ki / pi_one, (double)kff / pi_one, kp, ki, kff,
+		   curtailment_rate_max / 10.0, curtailment_ramp_up_default, curtailment_ramp_down_default);
+	printf("Plant - gensets %u kW (minimum load %.1f%%, droop %.1f%%), PV %u kW, PV tau %.0f ms, genset measurement tau %.0f ms\n",
+		   bench_genset_nodes * bench_genset_nominal_kw, curtailment_min_load / 10.0, bench_droop * 100,
+		   bench_pv_nodes * bench_pv_nominal_kw, bench_pv_tau * 1000, bench_genset_tau * 1000);
+	printf("Settling band +/-%.1f%% of genset nominal around the final genset power\n\n", bench_settling_band / 10.0);
+
+	passed&= bench_run_cases(0);
+	passed&= bench_run_cases(droop);
+
+	return(passed ? 0 : 1);
+}
@@ -0,0 +1,430 @@
+/*
+ * plant_sim.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: mniendicker
+ *
+ *      Closed loop host simulator - the whole firmware (main.cpp) runs on a
+ *      virtual clock against simulated Sungrow inverters (PV bus) and Sices
+ *      controllers (genset bus), register maps from pv_inverters.h and
+ *      genset_controllers.h
+ *
+ *      Usage: plant_sim [scenario] [load_profile] [irradiance_profile]
+ *      Scenarios: steps (default), reverse_power, genset_stop
+ *      Profiles replace the scenario ones: one "time[s] value" pair per line,
+ *      linear interpolation - load [kW], irradiance [0..1 of the PV nominal]
+ *
+ *      Report: curtailment latency, protection latency, genset minimum load
+ *      violations and bus scan times
+ *      Exit code 1 when a check of the scenario fails
+ */
+
+/*------------------------------------------------------------------
+ * 						HEADERS
+ * ----------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "../src/main.cpp"
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL CONSTANTS
+ * ----------------------------------------------------------------*/
+//Plant - PV inverters and gensets (Modbus addresses 1..n)
+static const uint8_t sim_pv_nodes= 4;
+static const uint16_t sim_pv_nominal_kw= 100;
+static const uint8_t sim_genset_nodes= 2;
+static const uint16_t sim_genset_nominal_kw= 250;
+
+//Dynamics time constants [s]
+static const double sim_pv_tau= 0.5;		//Inverter power response to a limit or irradiance change
+static const double sim_genset_tau= 0.2;	//Genset controller power measurement
+
+//Firmware loop execution time [us] and plant update period [s]
+static const uint32_t sim_loop_time= 50;
+static const double sim_plant_period= 0.01;
+
+//Genset stop - unloaded to a level [of its nominal power] in a time [s],
+//then its GCB opens; the controller keeps answering
+static const double sim_genset_unload_level= 0.05;
+static const double sim_genset_unload_time= 3.0;
+
+//Minimum load violations counted after the start up [s], below the
+//minimum load by more than the tolerance [0.1% of genset nominal]
+static const double sim_warm_up= 10.0;
+static const double sim_min_load_tolerance= 10;
+
+//Longest minimum load violation [s] - a step the curtailment corrects
+//within the PV response and the bus latency
+static const double sim_violation_bound= 2.5;
+
+//Report period [s]
+static const double sim_report_period= 5.0;
+
+//Protection latency bounds [us] - a broadcast turnaround in progress, then
+//one more for the protection broadcast to be acknowledged
+static const uint32_t sim_command_bound= ((uint32_t)pv_turnaround_delay_default + 20) * 1000;
+static const uint32_t sim_ack_bound= (2 * (uint32_t)pv_turnaround_delay_default + 50) * 1000;
+
+
+/*------------------------------------------------------------------
+ * 					GLOBAL VARIABLES
+ * ----------------------------------------------------------------*/
+//Piecewise linear profile
+typedef struct{
+	double time;
+	double value;
+}_sim_point;
+
+//Scenario - profiles and expected protection trips
+typedef struct{
+	const char *name;
+	double duration;						//[s]
+	std::vector<_sim_point> load;			//[kW]
+	std::vector<_sim_point> irradiance;		//[0..1 of the PV nominal power]
+	double genset_stop;						//Last genset stopped at [s] (0= none)
+	uint16_t trips_min;
+	uint16_t trips_max;
+	double violation_time_max;				//Time below the minimum load [s]
+}_sim_scenario;
+
+static const _sim_scenario sim_scenarios[]= {
+	//Load steps and a cloud passing - curtailment only
+	{"steps", 120,
+	 {{0, 400}, {30, 400}, {31, 250}, {60, 250}, {61, 450}, {120, 450}},
+	 {{0, 0.8}, {80, 0.8}, {85, 0.3}, {95, 0.3}, {100, 0.9}, {120, 0.9}},
+	 0, 0, 0, 8},
+	//Load rejection far below the PV power - reverse power trip, release and recovery
+	{"reverse_power", 90,
+	 {{0, 400}, {30, 400}, {30.1, 80}, {60, 80}, {61, 400}, {90, 400}},
+	 {{0, 0.8}, {90, 0.8}},
+	 0, 1, 1, 5},
+	//Normal stop of one genset, the other carries the island - the stopped
+	//genset must not hold the PV curtailed (at most one trip racing the
+	//GCB status read, released after the hold time)
+	{"genset_stop", 90,
+	 {{0, 300}, {90, 300}},
+	 {{0, 0.8}, {90, 0.8}},
+	 30, 0, 1, 2},
+};
+
+const _sim_scenario *sim_scenario;
+
+std::vector<_sim_point> sim_load;
+std::vector<_sim_point> sim_irradiance;
+
+//Plant state [W]
+double sim_pv_power[sim_pv_nodes];
+double sim_genset_power;
+double sim_genset_measured;
+
+//Minimum load violations
+typedef struct{
+	uint32_t events;
+	double time;				//Time below the minimum load [s]
+	double longest;				//Longest event [s]
+	double event_time;			//Time of the active event [s]
+	double worst;				//Deepest undershoot [W]
+	bool active;
+}_sim_violations;
+
+_sim_violations sim_violations;
+
+//Scan times - interval between new active power samples of node 0 [ms]
+typedef struct{
+	uint32_t last_sample;
+	uint32_t samples;
+	uint64_t total;
+	uint32_t max;
+}_sim_scan;
+
+_sim_scan sim_pv_scan;
+_sim_scan sim_genset_scan;
+
+//Loop execution time on the virtual clock (bus transfers included) [us]
+uint64_t sim_loop_max;
+
+
+/*------------------------------------------------------------------
+ * 					FUNCTIONS DEFINITION
+ * ----------------------------------------------------------------*/
+/*------------------------------------------------------------------
+ * Read a profile file - keep the default if it can not be read
+ * ----------------------------------------------------------------*/
+void sim_read_profile(const char *file, std::vector<_sim_point> *profile){
+	FILE *input= fopen(file, "r");
+	if(!input){
+		fprintf(stderr, "plant_sim: %s not found, default profile used\n", file);
+		return;
+	}
+
+	std::vector<_sim_point> points;
+	_sim_point point;
+	while(fscanf(input, "%lf %lf", &point.time, &point.value) == 2)
+		points.push_back(point);
+	fclose(input);
+
+	if(!points.empty())
+		*profile= points;
+}
+
+/*------------------------------------------------------------------
+ * Profile value at @time
+ * ----------------------------------------------------------------*/
+double sim_profile(const std::vector<_sim_point> &profile, double time){
+	if(time <= profile.front().time)
+		return(profile.front().value);
+
+	for(size_t i= 1; i < profile.size(); i++){
+		if(time <= profile[i].time){
+			const _sim_point &a= profile[i - 1];
+			const _sim_point &b= profile[i];
+			return(a.value + (b.value - a.value) * (time - a.time) / (b.time - a.time));
+		}
+	}
+	return(profile.back().value);
+}
+
+//Register constants are class members declared only (no definition) - the
+//unary + passes them by value to the std::map and comparison operators
+
+/*------------------------------------------------------------------
+ * Write a 32 bits value on two input registers (low word first)
+ * ----------------------------------------------------------------*/
+void sim_set_input32(Rs485Slave *slave, uint16_t address, uint32_t value){
+	slave->input[address]= value & 0xFFFF;
+	slave->input[address + 1]= value >> 16;
+}
+
+/*------------------------------------------------------------------
+ * Slaves configuration - nominal powers and breakers closed
+ * ----------------------------------------------------------------*/
+void sim_plant_init(){
+	for(uint8_t i= 0; i < sim_pv_nodes; i++){
+		Rs485Slave *slave= &Serial1.slaves[i + 1];
+		slave->input[+Sungrow::nominal_power]= sim_pv_nominal_kw * 10;	//0.1 kW
+		slave->holding[+Sungrow::enable_power_limit]= +Sungrow::enable_power_limit_off;
+		slave->holding[+Sungrow::power_limit_percent]= pv_power_limit_max;
+		sim_pv_power[i]= 0;
+	}
+
+	for(uint8_t i= 0; i < sim_genset_nodes; i++){
+		Rs485Slave *slave= &Serial2.slaves[i + 1];
+		slave->input[+Sices::nominal_power]= sim_genset_nominal_kw;		//kW
+		slave->input[+Sices::gcb_status]= +Sices::gcb_status_mask;		//GCB closed, MCB opened: island
+	}
+
+	sim_genset_power= sim_profile(sim_load, 0) * 1000;
+	sim_genset_measured= sim_genset_power;
+}
+
+/*------------------------------------------------------------------
+ * Plant step of @dt [s] at @time [s]
+ * PV: each inverter follows the irradiance, limited by its setpoint
+ * Gensets: take the load not supplied by PV, shared equally
+ * ----------------------------------------------------------------*/
+void sim_plant_step(double time, double dt){
+	double load= sim_profile(sim_load, time) * 1000;
+	double irradiance= sim_profile(sim_irradiance, time);
+	double pv_total= 0;
+
+	for(uint8_t i= 0; i < sim_pv_nodes; i++){
+		Rs485Slave *slave= &Serial1.slaves[i + 1];
+		double nominal= sim_pv_nominal_kw * 1000.0;
+		double target= irradiance * nominal;
+
+		if(slave->holding[+Sungrow::enable_power_limit] == +Sungrow::enable_power_limit_on){
+			double limit= slave->holding[+Sungrow::power_limit_percent] * nominal / 1000.0;
+			if(limit < target)
+				target= limit;
+		}
+
+		sim_pv_power[i]+= (target - sim_pv_power[i]) * ((dt < sim_pv_tau) ? (dt / sim_pv_tau) : 1.0);
+		pv_total+= sim_pv_power[i];
+		sim_set_input32(slave, +Sungrow::active_power, (uint32_t)sim_pv_power[i]);
+	}
+
+	//Island balance - gensets supply the rest (reverse power if negative)
+	sim_genset_power= load - pv_total;
+	sim_genset_measured+= (sim_genset_power - sim_genset_measured) * (dt / sim_genset_tau);
+
+	//Last genset stopping - unloaded, then off the bus (GCB opened)
+	uint8_t running= sim_genset_nodes;
+	double stopping_power= 0;
+	double stop= sim_scenario->genset_stop;
+	if((stop > 0) && (time >= stop)){
+		Rs485Slave *slave= &Serial2.slaves[sim_genset_nodes];
+		double share= sim_genset_measured / sim_genset_nodes;
+		double unloaded= sim_genset_unload_level * sim_genset_nominal_kw * 1000;
+		running--;
+		if(time < (stop + sim_genset_unload_time))
+			stopping_power= share + (unloaded - share) * (time - stop) / sim_genset_unload_time;
+		else
+			slave->input[+Sices::gcb_status]= 0x0000;
+	}
+
+	for(uint8_t i= 0; i < sim_genset_nodes; i++){
+		double power= (i < running) ? ((sim_genset_measured - stopping_power) / running) : stopping_power;
+		int32_t raw= (int32_t)(power * Sices::active_power_w_div / Sices::active_power_w_mul);
+		sim_set_input32(&Serial2.slaves[i + 1], +Sices::active_power, (uint32_t)raw);
+	}
+
+	//Minimum load violations
+	if(time < sim_warm_up)
+		return;
+
+	//Below the minimum load while PV is still producing (PV at zero can not
+	//help, the load itself is below the minimum)
+	double genset_nominal= (double)sim_genset_nodes * sim_genset_nominal_kw * 1000;
+	double min_load= genset_nominal * curtailment_min_load / 1000;
+	double tolerance= genset_nominal * sim_min_load_tolerance / 1000;
+	bool below= (sim_genset_power < (min_load - tolerance)) && (pv_total > tolerance);
+	if(below){
+		if(!sim_violations.active){
+			sim_violations.events++;
+			sim_violations.event_time= 0;
+		}
+		sim_violations.time+= dt;
+		sim_violations.event_time+= dt;
+		if(sim_violations.event_time > sim_violations.longest)
+			sim_violations.longest= sim_violations.event_time;
+		if((min_load - sim_genset_power) > sim_violations.worst)
+			sim_violations.worst= min_load - sim_genset_power;
+	}
+	sim_violations.active= below;
+}
+
+/*------------------------------------------------------------------
+ * New sample of node 0 at @sample_time [ms]
+ * ----------------------------------------------------------------*/
+void sim_scan_update(_sim_scan *scan, uint32_t sample_time){
+	if(sample_time == scan->last_sample)
+		return;
+
+	if(scan->last_sample != 0){
+		uint32_t interval= sample_time - scan->last_sample;
+		scan->samples++;
+		scan->total+= interval;
+		if(interval > scan->max)
+			scan->max= interval;
+	}
+	scan->last_sample= sample_time;
+}
+
+void sim_scan_report(const char *name, const _sim_scan *scan){
+	printf("  %-12s scan average %6.1f ms  max %6u ms\n", name,
+		   scan->samples ? (double)scan->total / scan->samples : 0.0, scan->max);
+}
+
+/*------------------------------------------------------------------
+ * Check @value against @bound - print the result
+ * Return false if above the bound
+ * ----------------------------------------------------------------*/
+bool sim_check(const char *name, double value, double bound){
+	bool ok= (value <= bound);
+	printf("  %-36s %10.1f <= %10.1f %s\n", name, value, bound, ok ? "ok" : "FAIL");
+	return(ok);
+}
+
+int main(int argc, char **argv){
+	const _sim_scenario *scenario= &sim_scenarios[0];
+	if(argc > 1){
+		scenario= NULL;
+		for(size_t i= 0; i < sizeof(sim_scenarios) / sizeof(sim_scenarios[0]); i++){
+			if(!strcmp(argv[1], sim_scenarios[i].name))
+				scenario= &sim_scenarios[i];
+		}
+		if(!scenario){
+			fprintf(stderr, "plant_sim: unknown scenario %s\n", argv[1]);
+			return(2);
+		}
+	}
+
+	sim_scenario= scenario;
+	double end= scenario->duration;
+	sim_load= scenario->load;
+	sim_irradiance= scenario->irradiance;
+	if(argc > 2)
+		sim_read_profile(argv[2], &sim_load);
+	if(argc > 3)
+		sim_read_profile(argv[3], &sim_irradiance);
+
+	sim_plant_init();
+
+	setup();
+	//Only the simulated nodes are configured
+	for(uint8_t i= sim_pv_nodes; i < pv_max_nodes; i++)
+		pv_set_node_type(i, NoInverter);
+	for(uint8_t i= sim_genset_nodes; i < genset_max_nodes; i++)
+		genset_set_node_type(i, NoGenset);
+
+	double plant_time= 0;
+	double report_time= 0;
+	printf("Scenario %s\n", scenario->name);
+	printf("   time    load      pv  genset  min_load  pv_limit  mode trip\n");
+
+	while(host_time_us < (uint64_t)(end * 1e6)){
+		uint64_t start= host_time_us;
+		loop();
+		host_time_us+= sim_loop_time;
+		if((host_time_us - start) > sim_loop_max)
+			sim_loop_max= host_time_us - start;
+
+		double time= host_time_us / 1e6;
+		if((time - plant_time) >= sim_plant_period){
+			sim_plant_step(time, time - plant_time);
+			plant_time= time;
+		}
+
+		sim_scan_update(&sim_pv_scan, pv_nodes[0].node_modbus_variables.active_power_time);
+		sim_scan_update(&sim_genset_scan, genset_nodes[0].node_modbus_variables.active_power_time);
+
+		if((time - report_time) >= sim_report_period){
+			report_time= time;
+			double pv_total= 0;
+			for(uint8_t i= 0; i < sim_pv_nodes; i++)
+				pv_total+= sim_pv_power[i];
+			printf("%7.1f %7.1f %7.1f %7.1f %9.1f %8.1f%% %5u %4u\n", time,
+				   sim_profile(sim_load, time), pv_total / 1000, sim_genset_power / 1000,
+				   (double)sim_genset_nodes * sim_genset_nominal_kw * curtailment_min_load / 1000,
+				   curtailment_pv_limit_percent / 10.0, operating_mode, protection_tripped);
+		}
+	}
+
+	printf("\nCurtailment latency (genset sample to setpoint acknowledged)\n");
+	printf("  last %u ms  max %u ms  bound %u ms  violations %u\n", pv_setpoint_latency.last,
+		   pv_setpoint_latency.max, pv_setpoint_latency.bound, pv_setpoint_latency.violations);
+	printf("Protection\n");
+	printf("  trips %u  command last %u us max %u us  acknowledge last %u us max %u us\n", protection_latency.trips,
+		   protection_latency.command_last, protection_latency.command_max, protection_latency.ack_last,
+		   protection_latency.ack_max);
+
+	printf("Genset minimum load violations (after %.0f s, tolerance %.1f%%)\n", sim_warm_up, sim_min_load_tolerance / 10);
+	printf("  events %u  time %.2f s  longest %.2f s  worst %.1f kW below\n", sim_violations.events,
+		   sim_violations.time, sim_violations.longest, sim_violations.worst / 1000);
+
+	printf("Scan times\n");
+	sim_scan_report("PV bus", &sim_pv_scan);
+	sim_scan_report("genset bus", &sim_genset_scan);
+	printf("  loop max %llu us (virtual clock, bus transfers included)\n", (unsigned long long)sim_loop_max);
+	printf("  PV bus frames %u (broadcast %u)  genset bus frames %u\n", Serial1.frames, Serial1.broadcasts,
+		   Serial2.frames);
+
+	printf("Checks\n");
+	bool passed= true;
+	passed&= sim_check("curtailment latency violations", pv_setpoint_latency.violations, 0);
+	passed&= sim_check("curtailment latency max [ms]", pv_setpoint_latency.max, pv_setpoint_latency.bound);
+	passed&= sim_check("minimum load violation time [s]", sim_violations.time, scenario->violation_time_max);
+	passed&= sim_check("minimum load violation longest [s]", sim_violations.longest, sim_violation_bound);
+	passed&= sim_check("protection trips (at least)", scenario->trips_min, protection_latency.trips);
+	passed&= sim_check("protection trips", protection_latency.trips, scenario->trips_max);
+	passed&= sim_check("protection command max [us]", protection_latency.command_max, sim_command_bound);
+	passed&= sim_check("protection acknowledge max [us]", protection_latency.ack_max, sim_ack_bound);
+	passed&= sim_check("protection tripped at the end", protection_tripped, 0);
+	passed&= sim_check("gensets signaled in reverse power at the end", genset_reverse_power_nodes, 0);
+
+	printf("\n%s %s\n", scenario->name, passed ? "PASS" : "FAIL");
+	return(passed ? 0 : 1);
+}